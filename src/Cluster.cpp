@@ -0,0 +1,690 @@
+#include "Cluster.hpp"
+
+#include "CostProfile.hpp"
+#include "FullSolver.hpp"
+#include "MonochromeShop.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+/*
+ * The job directory is the only channel between the coordinator and its workers:
+ *   job               settings of the solve, "<key> = <value>" per line
+ *   costs             the cost profile
+ *   pending/<shard>   shards nobody works on, either "seeds <first> <last>" or one "root <input>..." per line
+ *   claimed/<shard>.<worker>  shards being worked on, renamed from pending, the worker touches it as heartbeat
+ *   results/<shard>   one "route <seed> <input>..." per line for finished shards
+ *   best/<score>      empty files, the lowest name is the best score any worker found so far
+ *   done              written by the coordinator once it stops waiting for results
+ * Files are written to tmp first and renamed into place, so nobody ever reads a partial one.
+ */
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    using namespace std::chrono;
+
+    enum class JobKind
+    {
+        SEEDS,
+        ROOTS,
+    };
+
+    struct Job
+    {
+        JobKind kind = JobKind::SEEDS;
+        SolveSettings settings;
+    };
+
+    std::optional<uint32_t> parseNumber(const std::string& input)
+    {
+        uint32_t value;
+        auto [end, error] = std::from_chars(input.data(), input.data() + input.size(), value);
+        if (error != std::errc() || end != input.data() + input.size()) return std::nullopt;
+
+        return value;
+    }
+
+    std::string shardName(uint32_t index)
+    {
+        return std::format("{:06}", index);
+    }
+
+    bool writeFile(const fs::path& directory, const fs::path& target, const std::string& content)
+    {
+        // unique per process, two of them might write the same target
+        static const auto tag = std::format("{:08x}", std::random_device()());
+
+        auto temp = directory / "tmp" / (target.filename().string() + "." + tag);
+        {
+            std::ofstream file(temp, std::ios::binary);
+            if (!(file << content) || !file.flush()) return false;
+        }
+
+        std::error_code error;
+        fs::rename(temp, target, error);
+        return !error;
+    }
+
+    std::string writeInputs(const std::vector<Input>& inputs)
+    {
+        std::string line;
+        for (auto input : inputs)
+            line += " " + convertInput(input);
+
+        return line;
+    }
+
+    std::optional<std::vector<Input>> readInputs(std::istringstream& stream)
+    {
+        std::vector<Input> inputs;
+        std::string name;
+        while (stream >> name)
+        {
+            auto input = parseInput(name);
+            if (!input) return std::nullopt;
+            inputs.push_back(*input);
+        }
+
+        return inputs;
+    }
+
+    /*
+     * Job file
+     */
+
+    std::string writeJob(const Job& job)
+    {
+        auto& settings = job.settings;
+
+        std::ostringstream out;
+        out << "kind = " << (job.kind == JobKind::SEEDS ? "seeds" : "roots") << "\n";
+        out << "seed = " << settings.seed << "\n";
+        out << "advances = " << settings.advances << "\n";
+        out << "attempts = " << settings.attempts << "\n";
+        out << "score = " << settings.score << "\n";
+        out << "mode = " << convertMode(settings.mode) << "\n";
+        out << "depth = " << settings.depth << "\n";
+        out << "chunk_depth = " << settings.chunkDepth << "\n";
+        out << "top = " << settings.top << "\n";
+        out << "macro_fails = " << settings.macroLimits.fails << "\n";
+        out << "macro_cancels = " << settings.macroLimits.cancels << "\n";
+        out << "time_limit = " << settings.timeLimit.count() << "\n";
+        return out.str();
+    }
+
+    std::optional<Job> readJob(const fs::path& directory)
+    {
+        std::ifstream file(directory / "job");
+        auto costs = loadCostProfile((directory / "costs").string());
+        if (!file || !costs) return std::nullopt;
+
+        Job job;
+        job.settings.costs = *costs;
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            auto separator = line.find(" = ");
+            if (separator == std::string::npos) continue;
+
+            auto key    = line.substr(0, separator);
+            auto value  = line.substr(separator + 3);
+            auto number = parseNumber(value).value_or(0);
+
+            if (key == "kind")
+                job.kind = value == "roots" ? JobKind::ROOTS : JobKind::SEEDS;
+            else if (key == "mode")
+                job.settings.mode = convertMode(value);
+            else if (key == "seed")
+                job.settings.seed = number;
+            else if (key == "advances")
+                job.settings.advances = number;
+            else if (key == "attempts")
+                job.settings.attempts = number;
+            else if (key == "score")
+                job.settings.score = number;
+            else if (key == "depth")
+                job.settings.depth = static_cast<int32_t>(number);
+            else if (key == "chunk_depth")
+                job.settings.chunkDepth = static_cast<int32_t>(number);
+            else if (key == "top")
+                job.settings.top = number;
+            else if (key == "macro_fails")
+                job.settings.macroLimits.fails = number;
+            else if (key == "macro_cancels")
+                job.settings.macroLimits.cancels = number;
+            else if (key == "time_limit")
+                job.settings.timeLimit = milliseconds(number);
+        }
+
+        return job;
+    }
+
+    /*
+     * Shared best score
+     */
+
+    uint32_t readBest(const fs::path& directory)
+    {
+        uint32_t best = IMPOSSIBLE_SCORE;
+
+        std::error_code error;
+        for (auto& file : fs::directory_iterator(directory / "best", error))
+            best = std::min(best, parseNumber(file.path().filename().string()).value_or(IMPOSSIBLE_SCORE));
+
+        return best;
+    }
+
+    // what workers prune with, one above the best so that routes tying it still make it to the tie-break of mergeRoutes
+    uint32_t readBound(const fs::path& directory)
+    {
+        auto best = readBest(directory);
+        return best >= IMPOSSIBLE_SCORE ? IMPOSSIBLE_SCORE : best + 1;
+    }
+
+    void publishBest(const fs::path& directory, uint32_t score)
+    {
+        if (score < readBest(directory)) std::ofstream(directory / "best" / std::to_string(score));
+    }
+
+    /*
+     * Coordinator
+     */
+
+    class ShardWriter
+    {
+    private:
+        fs::path directory;
+        uint32_t shardSize;
+        std::string content;
+        uint32_t lines = 0;
+
+    public:
+        uint32_t count = 0;
+
+        ShardWriter(fs::path directory, uint32_t shardSize)
+            : directory(std::move(directory))
+            , shardSize(shardSize)
+        {
+        }
+
+        bool add(const std::string& line)
+        {
+            content += line + "\n";
+            return ++lines < shardSize || flush();
+        }
+
+        bool flush()
+        {
+            if (lines == 0) return true;
+
+            auto written = writeFile(directory, directory / "pending" / shardName(count++), content);
+            content.clear();
+            lines = 0;
+            return written;
+        }
+    };
+
+    /*
+     * Last change of a claim's stamp as the coordinator saw it. Only the change of the stamp counts, never its value,
+     * so the clocks of workers on other machines may be off by any amount.
+     */
+    struct ClaimSeen
+    {
+        fs::file_time_type stamp;
+        steady_clock::time_point changed;
+    };
+
+    void reissueStale(const fs::path& directory, std::map<std::string, ClaimSeen>& claims)
+    {
+        auto now = steady_clock::now();
+        std::set<std::string> present;
+
+        std::error_code error;
+        for (auto& file : fs::directory_iterator(directory / "claimed", error))
+        {
+            auto name  = file.path().filename().string();
+            auto shard = name.substr(0, name.find('.'));
+            present.insert(name);
+
+            // the worker died between writing its result and dropping the claim
+            if (fs::exists(directory / "results" / shard))
+            {
+                fs::remove(file.path(), error);
+                continue;
+            }
+
+            auto stamp          = fs::last_write_time(file.path(), error);
+            auto [claim, added] = claims.try_emplace(name, ClaimSeen{ stamp, now });
+            if (!added && claim->second.stamp != stamp) claim->second = { stamp, now };
+            if (now - claim->second.changed < SHARD_TIMEOUT) continue;
+
+            std::cerr << "Reissuing shard " << shard << " of worker " << name.substr(shard.size() + 1) << "\n";
+            fs::rename(file.path(), directory / "pending" / shard, error);
+            present.erase(name);
+        }
+
+        // forget finished and reissued claims, so that a new claim of the same name starts over
+        std::erase_if(claims, [&](const auto& claim) { return !present.contains(claim.first); });
+    }
+
+    struct Route
+    {
+        uint32_t seed;
+        std::vector<Input> inputs;
+        ISolveEntry entry;
+    };
+
+    std::vector<Input> toInputs(const ISolveEntry& entry)
+    {
+        std::vector<Input> inputs;
+        for (auto& val : entry.getInputs())
+            inputs.push_back(val.input);
+
+        return inputs;
+    }
+
+    std::vector<Route> readRoutes(const fs::path& directory, uint32_t shards, uint32_t score)
+    {
+        std::vector<Route> routes;
+        for (uint32_t i = 0; i < shards; i++)
+        {
+            std::ifstream file(directory / "results" / shardName(i));
+
+            std::string line;
+            while (std::getline(file, line))
+            {
+                std::istringstream stream(line);
+                std::string type;
+                uint32_t seed;
+                if (!(stream >> type >> seed) || type != "route") continue;
+
+                auto inputs = readInputs(stream);
+                if (!inputs) continue;
+
+                auto first    = std::ranges::find_if(*inputs, [](Input input) { return input != Input::CATCH_UP; });
+                auto advances = static_cast<uint32_t>(first - inputs->begin());
+
+                // rebuilt instead of trusted, a worker might have run with different code
+                FullSolveEntry<DynamicCosts> entry(seed, advances);
+                for (auto it = first; it != inputs->end(); it++)
+                    entry.apply(*it);
+
+                auto shop = entry.getShop();
+                if (!shop.hasEnded() || shop.getProfits() < REQUIRED_PROFITS || entry.getScore() >= score)
+                {
+                    std::cerr << "Dropping invalid route of shard " << shardName(i) << "\n";
+                    continue;
+                }
+
+                routes.push_back({ seed, std::move(*inputs), std::move(entry) });
+            }
+        }
+
+        return routes;
+    }
+
+    // the same results always come out in the same order, no matter which worker found them first
+    std::vector<ISolveEntry> mergeRoutes(std::vector<Route> routes, uint32_t top)
+    {
+        std::ranges::sort(routes, [&](const Route& a, const Route& b)
+                          { return std::make_tuple(a.entry.getScore(), a.seed, a.inputs) <
+                                   std::make_tuple(b.entry.getScore(), b.seed, b.inputs); });
+
+        std::vector<ISolveEntry> results;
+        for (size_t i = 0; i < routes.size() && results.size() < top; i++)
+        {
+            if (i > 0 && routes[i].seed == routes[i - 1].seed && routes[i].inputs == routes[i - 1].inputs) continue;
+            results.push_back(routes[i].entry);
+        }
+
+        return results;
+    }
+
+    /*
+     * Worker
+     */
+
+    std::optional<std::string> claimShard(const fs::path& directory, const std::string& worker)
+    {
+        std::vector<std::string> names;
+
+        std::error_code error;
+        for (auto& file : fs::directory_iterator(directory / "pending", error))
+            names.push_back(file.path().filename().string());
+
+        // lowest first, for subtree shards these hold the roots with the best bounds
+        std::ranges::sort(names);
+        for (auto& name : names)
+        {
+            fs::rename(directory / "pending" / name, directory / "claimed" / (name + "." + worker), error);
+            if (!error) return name;
+        }
+
+        return std::nullopt;
+    }
+
+    class Heartbeat
+    {
+    private:
+        std::mutex mutex;
+        BestResult* result = nullptr;
+
+    public:
+        std::stop_source revoked; // set when the claim is gone, i.e. the shard got reissued
+
+    private:
+        std::jthread thread;
+
+    public:
+        Heartbeat(const fs::path& directory, const fs::path& claim, uint32_t top)
+        {
+            thread = std::jthread(
+                [this, directory, claim, top](std::stop_token token)
+                {
+                    std::condition_variable_any wakeup;
+                    std::unique_lock lock(mutex);
+
+                    while (!token.stop_requested())
+                    {
+                        std::error_code error;
+                        fs::last_write_time(claim, fs::file_time_type::clock::now(), error);
+                        if (error) revoked.request_stop();
+
+                        // only a single best can take a bound from somewhere else
+                        if (result && top == 1) result->tighten(readBound(directory));
+
+                        wakeup.wait_for(lock, token, SHARD_HEARTBEAT_INTERVAL, [] { return false; });
+                    }
+                });
+        }
+
+        void watch(BestResult* best)
+        {
+            std::scoped_lock lock(mutex);
+            result = best;
+        }
+    };
+
+    // returns the result lines, nothing when the shard has to be solved again, by this worker or another one.
+    // Running out of the time limit finishes it with the routes found so far, like it does for a single solve.
+    std::optional<std::string> solveShard(const fs::path& directory,
+                                          const Job& job,
+                                          const fs::path& claim,
+                                          SolveCache& cache,
+                                          Heartbeat& heartbeat)
+    {
+        auto& settings = job.settings;
+        auto token     = heartbeat.revoked.get_token();
+        std::ifstream file(claim);
+        std::string lines;
+
+        auto addRoutes = [&](uint32_t seed, const BestResult& result)
+        {
+            for (auto& entry : result.getResults())
+                lines += std::format("route {}{}\n", seed, writeInputs(toInputs(entry)));
+
+            if (settings.top == 1) publishBest(directory, result.getBestScore());
+        };
+
+        if (job.kind == JobKind::SEEDS)
+        {
+            std::string type;
+            uint32_t first, last;
+            if (!(file >> type >> first >> last)) return std::nullopt;
+
+            for (uint64_t seed = first; seed <= last; seed++)
+            {
+                SolveSettings seedSettings = settings;
+                seedSettings.seed          = static_cast<uint32_t>(seed);
+                if (settings.top == 1) seedSettings.score = std::min(settings.score, readBound(directory));
+
+                auto result = solve(seedSettings, cache, nullptr, token);
+                if (stop || token.stop_requested()) return std::nullopt;
+
+                addRoutes(seedSettings.seed, result);
+            }
+
+            return lines;
+        }
+
+        std::vector<std::vector<Input>> roots;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            std::string type;
+            stream >> type;
+
+            auto inputs = readInputs(stream);
+            if (type != "root" || !inputs) return std::nullopt;
+            roots.push_back(std::move(*inputs));
+        }
+
+        uint32_t score = settings.top == 1 ? std::min(settings.score, readBound(directory)) : settings.score;
+
+        // solveRoots doesn't go through solve(), so the time limit of the shard gets armed here
+        std::stop_source source;
+        std::stop_callback forward(token, [&source] { source.request_stop(); });
+        BestResult result(score, settings.top, source.get_token());
+
+        bool solved;
+        heartbeat.watch(&result);
+        {
+            StopTimer timer(source, settings.timeLimit);
+            solved = solveRoots(settings, roots, result);
+        }
+        heartbeat.watch(nullptr);
+
+        if (!solved || stop || token.stop_requested()) return std::nullopt;
+
+        addRoutes(settings.seed, result);
+        return lines;
+    }
+} // namespace
+
+/*
+ * Coordinator implementation
+ */
+
+int coordinate(const std::string& directoryName,
+               const SolveSettings& settings,
+               std::optional<SeedRange> seeds,
+               uint32_t shardSize,
+               SolveOutput& output)
+{
+    fs::path directory(directoryName);
+    auto start = high_resolution_clock::now();
+
+    if (fs::exists(directory / "job"))
+    {
+        std::cerr << directory.string() << " already holds a job, use an empty directory\n";
+        return 1;
+    }
+    if (!seeds && settings.mode != Mode::DEEP && settings.mode != Mode::COMBINED)
+    {
+        std::cerr << "A single seed can only be split with the deep or combined mode, use --seeds otherwise\n";
+        return 1;
+    }
+    if (shardSize == 0)
+    {
+        std::cerr << "Shards need at least one seed or subtree\n";
+        return 1;
+    }
+    if (seeds && seeds->first > seeds->last)
+    {
+        std::cerr << "Empty seed range\n";
+        return 1;
+    }
+
+    std::error_code error;
+    for (auto sub : { "tmp", "pending", "claimed", "results", "best" })
+        fs::create_directories(directory / sub, error);
+
+    Job job = { .kind = seeds ? JobKind::SEEDS : JobKind::ROOTS, .settings = settings };
+    if (error || !saveCostProfile(settings.costs, (directory / "costs").string()) ||
+        !writeFile(directory, directory / "job", writeJob(job)))
+    {
+        std::cerr << "Can't write the job to " << directory.string() << "\n";
+        return 1;
+    }
+
+    output.start(toParameters(settings));
+
+    // routes found while splitting, they never make it into a shard
+    BestResult rootResult(settings.score, settings.top);
+    ShardWriter shards(directory, seeds ? 1 : shardSize);
+    bool written = true;
+
+    if (seeds)
+    {
+        for (uint64_t first = seeds->first; first <= seeds->last; first += shardSize)
+        {
+            auto last = std::min<uint64_t>(first + shardSize - 1, seeds->last);
+            written   = written && shards.add(std::format("seeds {} {}", first, last));
+        }
+    }
+    else
+    {
+        if (settings.mode == Mode::COMBINED)
+        {
+            // a quick heuristic bound prunes the roots before they get handed out
+            SolveSettings heuristic = settings;
+            heuristic.mode          = Mode::HEURISTIC;
+
+            SolveCache cache;
+            for (auto& entry : solve(heuristic, cache).getResults())
+                rootResult.updateScore(entry);
+            if (settings.top == 1) publishBest(directory, rootResult.getBestScore());
+        }
+
+        auto addRoot = [&](const std::vector<Input>& inputs)
+        { written = written && shards.add("root" + writeInputs(inputs)); };
+        if (!expandRoots(settings, rootResult, addRoot)) return 1;
+    }
+    written = written && shards.flush();
+
+    if (!written)
+    {
+        std::cerr << "Can't write the shards to " << directory.string() << "\n";
+        return 1;
+    }
+
+    std::cerr << "Waiting for workers on " << shards.count << " shards\n";
+
+    std::map<std::string, ClaimSeen> claims;
+    uint32_t reported = 0;
+    while (!stop)
+    {
+        uint32_t finished = 0;
+        for (uint32_t i = 0; i < shards.count; i++)
+            finished += fs::exists(directory / "results" / shardName(i));
+
+        if (finished != reported)
+        {
+            std::cerr << finished << "/" << shards.count << " shards done\n";
+            reported = finished;
+        }
+        if (finished == shards.count) break;
+
+        reissueStale(directory, claims);
+        std::this_thread::sleep_for(CLUSTER_POLL_INTERVAL);
+    }
+
+    // workers quit once they see this, even when the coordinator got stopped early
+    std::ofstream(directory / "done");
+
+    // shard results get rebuilt with the profile of the job, the same way for every format
+    auto costs  = DynamicCosts::acquire(settings.costs);
+    auto routes = readRoutes(directory, shards.count, settings.score);
+
+    for (auto& entry : rootResult.getResults())
+        routes.push_back({ settings.seed, toInputs(entry), entry });
+
+    output.finished(mergeRoutes(std::move(routes), settings.top),
+                    duration_cast<milliseconds>(high_resolution_clock::now() - start));
+    return 0;
+}
+
+/*
+ * Worker implementation
+ */
+
+int work(const std::string& directoryName)
+{
+    fs::path directory(directoryName);
+
+    std::random_device random;
+    auto worker = std::format("{:08x}{:08x}", random(), random());
+
+    while (!stop && !fs::exists(directory / "job"))
+        std::this_thread::sleep_for(CLUSTER_POLL_INTERVAL);
+    if (stop) return 1;
+
+    auto job = readJob(directory);
+    if (!job)
+    {
+        std::cerr << "Can't read the job in " << directory.string() << "\n";
+        return 1;
+    }
+
+    std::cerr << "Worker " << worker << " joined\n";
+
+    SolveCache cache;
+    while (!stop && !fs::exists(directory / "done"))
+    {
+        auto shard = claimShard(directory, worker);
+        if (!shard)
+        {
+            std::this_thread::sleep_for(CLUSTER_POLL_INTERVAL);
+            continue;
+        }
+
+        auto claim = directory / "claimed" / (*shard + "." + worker);
+        std::optional<std::string> lines;
+        bool revoked;
+        {
+            Heartbeat heartbeat(directory, claim, job->settings.top);
+            lines   = solveShard(directory, *job, claim, cache, heartbeat);
+            revoked = heartbeat.revoked.stop_requested();
+        }
+
+        std::error_code error;
+        if (revoked)
+        {
+            std::cerr << "Lost shard " << *shard << "\n";
+            continue;
+        }
+        if (!lines)
+        {
+            // hand it back right away instead of waiting for the timeout
+            fs::rename(claim, directory / "pending" / *shard, error);
+            continue;
+        }
+
+        if (!writeFile(directory, directory / "results" / *shard, *lines))
+        {
+            std::cerr << "Can't write the result of shard " << *shard << "\n";
+            return 1;
+        }
+        fs::remove(claim, error);
+        std::cerr << "Finished shard " << *shard << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Output.hpp"
+#include "Solver.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+constexpr uint32_t DEFAULT_SHARD_SIZE   = 64;                            // seeds or subtree roots per shard
+constexpr auto CLUSTER_POLL_INTERVAL    = std::chrono::milliseconds(500);
+constexpr auto SHARD_HEARTBEAT_INTERVAL = std::chrono::seconds(2);
+constexpr auto SHARD_TIMEOUT            = std::chrono::seconds(30); // heartbeat age before a shard gets reissued
+
+struct SeedRange
+{
+    uint32_t first;
+    uint32_t last; // inclusive
+};
+
+/*
+ * Splits a solve into shards in the given directory, which workers on any machine sharing it pick up, and merges
+ * their results into the output once all are done. A seed range gets split into runs of seeds, a single seed into
+ * the subtrees of its deep solve. Shards of workers that stop sending heartbeats get reissued.
+ * Returns the exit code.
+ */
+int coordinate(const std::string& directory,
+               const SolveSettings& settings,
+               std::optional<SeedRange> seeds,
+               uint32_t shardSize,
+               SolveOutput& output);
+
+/*
+ * Solves shards of the job in the given directory until the coordinator marks it as done or ctrl+C.
+ * Returns the exit code.
+ */
+int work(const std::string& directory);
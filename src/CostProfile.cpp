@@ -0,0 +1,130 @@
+#include "CostProfile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <utility>
+
+namespace
+{
+    // only written without any leases, so solves never see it change under them
+    CostProfile dynamicProfile;
+    std::mutex leaseMutex;
+    uint32_t leases = 0;
+
+    constexpr std::pair<std::string_view, uint32_t CostProfile::*> profileKeys[] = {
+        { "raise", &CostProfile::raise },
+        { "normal", &CostProfile::normal },
+        { "lower", &CostProfile::lower },
+        { "cancel", &CostProfile::cancel },
+        { "static", &CostProfile::staticCost },
+        { "deny", &CostProfile::deny },
+        { "meat", &CostProfile::meat },
+        { "non_mucho_medicine", &CostProfile::nonMuchoMedicine },
+        { "advance", &CostProfile::advance },
+        { "goburimon_walk", &CostProfile::goburimonWalk },
+        { "gotsumon_walk", &CostProfile::gotsumonWalk },
+        { "muchomon_walk", &CostProfile::muchomonWalk },
+        { "weedmon_walk", &CostProfile::weedmonWalk },
+    };
+
+    std::string trim(const std::string& input)
+    {
+        auto first = input.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return "";
+
+        auto last = input.find_last_not_of(" \t\r");
+        return input.substr(first, last - first + 1);
+    }
+} // namespace
+
+/*
+ * DynamicCosts implementation
+ */
+
+DynamicCosts::Lease::~Lease()
+{
+    if (!held) return;
+
+    std::scoped_lock lock(leaseMutex);
+    leases--;
+}
+
+const CostProfile& DynamicCosts::get()
+{
+    return dynamicProfile;
+}
+
+DynamicCosts::Lease DynamicCosts::acquire(const CostProfile& profile)
+{
+    std::scoped_lock lock(leaseMutex);
+    if (leases > 0 && dynamicProfile != profile)
+    {
+        std::cerr << "Can't switch the cost profile while a solve is running with another one\n";
+        return Lease(false);
+    }
+
+    if (leases++ == 0) dynamicProfile = profile;
+    return Lease(true);
+}
+
+std::optional<CostProfile> loadCostProfile(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Can't open cost profile " << path << "\n";
+        return std::nullopt;
+    }
+
+    CostProfile profile;
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        auto separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            std::cerr << path << ":" << lineNumber << ": expected <name> = <frames>\n";
+            return std::nullopt;
+        }
+
+        auto name = trim(line.substr(0, separator));
+        auto key  = std::find_if(std::begin(profileKeys),
+                                std::end(profileKeys),
+                                [&](const auto& val) { return val.first == name; });
+        if (key == std::end(profileKeys))
+        {
+            std::cerr << path << ":" << lineNumber << ": unknown cost " << name << "\n";
+            return std::nullopt;
+        }
+
+        // from_chars, unlike a stream, doesn't wrap a negative value around into a huge one
+        auto value = trim(line.substr(separator + 1));
+        uint32_t frames;
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), frames);
+        if (error != std::errc() || end != value.data() + value.size())
+        {
+            std::cerr << path << ":" << lineNumber << ": invalid value for " << name << "\n";
+            return std::nullopt;
+        }
+
+        profile.*(key->second) = frames;
+    }
+
+    return profile;
+}
+
+bool saveCostProfile(const CostProfile& profile, const std::string& path)
+{
+    std::ofstream file(path);
+    for (auto& [name, member] : profileKeys)
+        file << name << " = " << profile.*member << "\n";
+
+    return static_cast<bool>(file.flush());
+}
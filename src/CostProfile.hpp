@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+constexpr uint32_t RAISE_COST              = 12;
+constexpr uint32_t NORMAL_COST             = 17;
+constexpr uint32_t LOWER_COST              = 17;
+constexpr uint32_t CANCEL_COST             = 16;
+constexpr uint32_t STATIC_COST             = 100; // spawn + request + react + wait
+constexpr uint32_t DENY_COST               = 36;
+constexpr uint32_t MEAT_COST               = 10;
+constexpr uint32_t NON_MUCHO_MEDICINE_COST = 10;
+constexpr uint32_t ADVANCE_COST            = 20;
+constexpr uint32_t GOBURIMON_WALK_COST     = 82;
+constexpr uint32_t GOTSUMON_WALK_COST      = 73;
+constexpr uint32_t MUCHOMON_WALK_COST      = 71;
+constexpr uint32_t WEEDMON_WALK_COST       = 65;
+
+/*
+ * Timings used to score a sequence, in frames.
+ */
+struct CostProfile
+{
+    uint32_t raise            = RAISE_COST;
+    uint32_t normal           = NORMAL_COST;
+    uint32_t lower            = LOWER_COST;
+    uint32_t cancel           = CANCEL_COST;
+    uint32_t staticCost       = STATIC_COST;
+    uint32_t deny             = DENY_COST;
+    uint32_t meat             = MEAT_COST;
+    uint32_t nonMuchoMedicine = NON_MUCHO_MEDICINE_COST;
+    uint32_t advance          = ADVANCE_COST;
+    uint32_t goburimonWalk    = GOBURIMON_WALK_COST;
+    uint32_t gotsumonWalk     = GOTSUMON_WALK_COST;
+    uint32_t muchomonWalk     = MUCHOMON_WALK_COST;
+    uint32_t weedmonWalk      = WEEDMON_WALK_COST;
+
+    bool operator==(const CostProfile& other) const = default;
+};
+
+inline constexpr CostProfile DEFAULT_COSTS = {};
+
+/*
+ * Cost policies the solver entries are instantiated with.
+ * StaticCosts bakes a known profile into the instantiation, so its values get constant folded like before.
+ * DynamicCosts reads the process-wide runtime profile and is only used for custom profiles.
+ */
+template<const CostProfile& Profile>
+struct StaticCosts
+{
+    static constexpr const CostProfile& get() { return Profile; }
+};
+
+struct DynamicCosts
+{
+    /*
+     * Keeps the runtime profile from changing while it's alive, everything that reads it has to hold one.
+     * Converts to false when it couldn't be acquired.
+     */
+    class Lease
+    {
+    private:
+        bool held;
+
+    public:
+        explicit Lease(bool held)
+            : held(held)
+        {
+        }
+
+        Lease(Lease&& other) noexcept
+            : held(std::exchange(other.held, false))
+        {
+        }
+
+        Lease(const Lease&)            = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&)      = delete;
+        ~Lease();
+
+        explicit operator bool() const { return held; }
+    };
+
+    static const CostProfile& get();
+
+    // makes the given profile the runtime one, fails and prints the problem while a lease on a different one is alive
+    [[nodiscard]] static Lease acquire(const CostProfile& profile);
+};
+
+using DefaultCosts = StaticCosts<DEFAULT_COSTS>;
+
+/*
+ * Calls function with DefaultCosts or DynamicCosts as argument, depending on the profile. The built-in profile gets
+ * its own instantiation, everything else goes through the runtime profile, which is held at the given one until
+ * function returns. Prints the problem and returns false without calling function when a running solve is using
+ * another profile.
+ */
+template<typename Function>
+[[nodiscard]] bool withCosts(const CostProfile& costs, Function&& function)
+{
+    if (costs == DEFAULT_COSTS)
+    {
+        function(DefaultCosts{});
+        return true;
+    }
+
+    auto lease = DynamicCosts::acquire(costs);
+    if (!lease) return false;
+
+    function(DynamicCosts{});
+    return true;
+}
+
+/*
+ * Reads a cost profile file. Each line has the form "<name> = <frames>", '#' starts a comment.
+ * Names not given in the file keep their default value. Prints the problem and returns nothing on errors.
+ */
+std::optional<CostProfile> loadCostProfile(const std::string& path);
+
+/*
+ * Writes every cost of the profile in the format loadCostProfile reads. Returns whether it succeeded.
+ */
+bool saveCostProfile(const CostProfile& profile, const std::string& path);
@@ -10,6 +10,8 @@ private:
     uint32_t state;
 
 public:
+    static constexpr uint32_t range = 0x8000; // next() yields 15 bit
+
     DW1Random(uint32_t seed)
         : state(seed)
     {
@@ -27,11 +29,13 @@ public:
             next();
     }
 
-    uint32_t next(uint32_t limit) { return (next() * limit) >> 0xF; }
+    uint32_t next(uint32_t limit) { return scale(next(), limit); }
+
+    static constexpr uint32_t scale(uint16_t raw, uint32_t limit) { return (raw * limit) >> 0xF; }
 
     uint32_t nextModulo(uint32_t limit) { return next() % limit; }
 
-    uint32_t getState() { return state; }
+    uint32_t getState() const { return state; }
 
     void setState(uint32_t new_state) {  state = new_state; }
 };
\ No newline at end of file
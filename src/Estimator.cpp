@@ -0,0 +1,220 @@
+#include "Estimator.hpp"
+
+#include "Frontier.hpp"
+#include "RngLookahead.hpp"
+
+#include <algorithm>
+#include <format>
+#include <numeric>
+#include <random>
+#include <string>
+
+namespace
+{
+    using namespace std::chrono;
+
+    // the best of a few heuristic attempts per advance, like the combined solver starts with
+    template<typename Costs>
+    void findBound(const SolveSettings& settings, TreeEstimate& estimate)
+    {
+        estimate.bound = settings.score;
+
+        // with more than one route kept the bound is the worst of them, a single heuristic route says nothing
+        if (settings.score != IMPOSSIBLE_SCORE || settings.top > 1) return;
+
+        BestResult best(settings.score);
+        for (uint32_t i = 0; i <= settings.advances && !stop; i++)
+        {
+            for (uint32_t j = 0; j < ESTIMATE_HEURISTIC; j++)
+            {
+                HeuristicSolveEntry<Costs> entry(settings.seed, i);
+                entry.next(best);
+            }
+        }
+
+        // shorter than the depth, the deep solver never checks whether a node at the depth limit ended the shop
+        auto route              = best.getBest();
+        estimate.bound          = best.getScore();
+        estimate.heuristicRoute = route && static_cast<int32_t>(route->getInputs().size()) < settings.depth;
+
+        if (route)
+        {
+            auto inputs            = route->getInputs();
+            auto isAdvance         = [](const auto& step) { return step.input == Input::CATCH_UP; };
+            auto firstInput        = std::ranges::find_if_not(inputs, isAdvance);
+            estimate.routeAdvances = static_cast<uint32_t>(firstInput - inputs.begin());
+        }
+    }
+
+    // expected nodes per level below root, averaged over random walks that pick every child with equal probability
+    template<typename Costs>
+    std::vector<double> probeLevels(const FullSolveEntry<Costs>& root,
+                                    int32_t levels,
+                                    uint32_t bound,
+                                    std::mt19937_64& rng)
+    {
+        std::vector<double> nodes;
+        for (uint32_t i = 0; i < ESTIMATE_PROBES && !stop; i++)
+        {
+            // one per walk, so that a route found at its end doesn't lower the bound for the others
+            BestResult best(bound);
+            FullSolveEntry<Costs> node = root;
+            double weight              = 1;
+
+            for (int32_t level = 0;; level++)
+            {
+                if (nodes.size() <= static_cast<size_t>(level)) nodes.resize(level + 1);
+                nodes[level] += weight;
+                if (level >= levels) break;
+
+                auto children = node.next(best);
+                if (children.empty()) break;
+
+                weight *= static_cast<double>(children.size());
+                node = std::move(children[rng() % children.size()]);
+            }
+        }
+
+        for (auto& count : nodes)
+            count /= ESTIMATE_PROBES;
+
+        return nodes;
+    }
+
+    // nodes per second of frontier expansion, on the tree of the first advance
+    template<typename Costs>
+    double measureRate(const FullSolveEntry<Costs>& root, int32_t levels, uint32_t bound)
+    {
+        BestResult best(bound);
+        Frontier<Costs> frontier(root);
+
+        size_t expanded = 0;
+        auto start      = steady_clock::now();
+        for (int32_t i = 0; i < levels && frontier.size() > 0 && expanded < ESTIMATE_CALIBRATION && !stop; i++)
+        {
+            expanded += frontier.size();
+            frontier.expand(best);
+        }
+
+        auto seconds = duration<double>(steady_clock::now() - start).count();
+        return seconds > 0 ? expanded / seconds : 0;
+    }
+
+    template<typename Costs>
+    TreeEstimate estimateTreeOf(const SolveSettings& settings)
+    {
+        RngLookahead lookahead(settings.seed);
+        std::mt19937_64 rng(settings.seed);
+
+        TreeEstimate estimate;
+        estimate.seed = settings.seed;
+        findBound<Costs>(settings, estimate);
+
+        for (uint32_t i = 0; i <= settings.advances; i++)
+        {
+            FullSolveEntry<Costs> root(settings.seed, i, &lookahead);
+            auto levels = std::max(settings.depth - static_cast<int32_t>(root.getInputs().size()), 0);
+
+            auto nodes = probeLevels(root, levels, estimate.bound, rng);
+            estimate.advanceNodes.push_back(std::reduce(nodes.begin(), nodes.end(), 0.0));
+            estimate.levelNodes.push_back(std::move(nodes));
+
+            if (i == 0) estimate.nodesPerSecond = measureRate(root, levels, estimate.bound);
+        }
+
+        return estimate;
+    }
+
+    std::string formatRuntime(milliseconds runtime)
+    {
+        if (runtime < seconds(10)) return std::format("{} ms", runtime.count());
+        if (runtime < hours(2)) return std::format("{} s", duration_cast<seconds>(runtime).count());
+        return std::format("{} h", duration_cast<hours>(runtime).count());
+    }
+} // namespace
+
+/*
+ * TreeEstimate implementation
+ */
+
+double TreeEstimate::getNodes(uint32_t advances) const
+{
+    auto count = std::min<size_t>(advances + 1, advanceNodes.size());
+    return std::reduce(advanceNodes.begin(), advanceNodes.begin() + count, 0.0);
+}
+
+milliseconds TreeEstimate::getRuntime(uint32_t advances) const
+{
+    if (nodesPerSecond <= 0) return {};
+    return duration_cast<milliseconds>(duration<double>(getNodes(advances) / nodesPerSecond));
+}
+
+TreeEstimate estimateTree(const SolveSettings& settings)
+{
+    // only fails next to a solve with another profile, which the command line never runs
+    TreeEstimate estimate;
+    [[maybe_unused]] auto estimated =
+        withCosts(settings.costs, [&]<typename Costs>(Costs) { estimate = estimateTreeOf<Costs>(settings); });
+    return estimate;
+}
+
+SolveSettings autoTune(const SolveSettings& settings, const TreeEstimate& estimate)
+{
+    SolveSettings tuned = settings;
+
+    // deeper chunks sort more of the tree by bound at once, until the frontier gets too big to hold and expand
+    tuned.chunkDepth = AUTO_MIN_CHUNK_DEPTH;
+    for (int32_t level = AUTO_MIN_CHUNK_DEPTH + 1; level <= AUTO_MAX_CHUNK_DEPTH; level++)
+    {
+        double widest = 0;
+        for (auto& levels : estimate.levelNodes)
+        {
+            if (static_cast<size_t>(level) < levels.size()) widest = std::max(widest, levels[level]);
+        }
+
+        if (widest > AUTO_FRONTIER_TARGET) break;
+        tuned.chunkDepth = level;
+    }
+
+    // the largest window that is still expected to be exhausted within the time limit, if not even the first one is
+    // the limit only cuts an anytime search short and the helpers get to look at every advance
+    if (settings.timeLimit.count() > 0 && estimate.getRuntime(0) <= settings.timeLimit)
+    {
+        tuned.advances = 0;
+        for (uint32_t i = 1; i <= settings.advances && estimate.getRuntime(i) <= settings.timeLimit; i++)
+            tuned.advances = i;
+    }
+
+    // the helpers would only find the heuristic route again, start the deep solver right below it instead. Only if
+    // the window still holds the route, a deep solve that can't find it again would come back empty.
+    bool quick   = estimate.getRuntime(tuned.advances) < AUTO_DEEP_ONLY;
+    bool inReach = estimate.heuristicRoute && estimate.routeAdvances <= tuned.advances;
+    if (settings.mode == Mode::COMBINED && inReach && quick)
+    {
+        tuned.mode  = Mode::DEEP;
+        tuned.score = estimate.bound + 1;
+    }
+
+    return tuned;
+}
+
+void printEstimate(const TreeEstimate& estimate, std::ostream& out)
+{
+    out << std::format("Estimated search tree of seed {} at bound {}:\n", estimate.seed, estimate.bound);
+    for (uint32_t i = 0; i < estimate.advanceNodes.size(); i++)
+        out << std::format("  {} advances: {:.0f} nodes\n", i, estimate.advanceNodes[i]);
+
+    auto advances = static_cast<uint32_t>(estimate.advanceNodes.size()) - 1;
+    out << std::format("  total: {:.0f} nodes at {:.0f} nodes/s, about {}\n",
+                       estimate.getNodes(advances),
+                       estimate.nodesPerSecond,
+                       formatRuntime(estimate.getRuntime(advances)));
+}
+
+void printTuning(const SolveSettings& settings, std::ostream& out)
+{
+    out << std::format("Auto settings: mode {}, {} advances, chunk depth {}\n",
+                       convertMode(settings.mode),
+                       settings.advances,
+                       settings.chunkDepth);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Solver.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+constexpr uint32_t ESTIMATE_PROBES     = 4096;    // random walks per advance
+constexpr uint32_t ESTIMATE_HEURISTIC  = 1 << 14; // heuristic attempts per advance for a bound, unless one is given
+constexpr size_t ESTIMATE_CALIBRATION  = 1 << 18; // frontier nodes timed for the node rate
+constexpr double AUTO_FRONTIER_TARGET  = 1 << 20; // most nodes --auto lets the widest frontier level have
+constexpr int32_t AUTO_MIN_CHUNK_DEPTH = 4;
+constexpr int32_t AUTO_MAX_CHUNK_DEPTH = 16;
+constexpr auto AUTO_DEEP_ONLY          = std::chrono::milliseconds(2000); // below, helper threads don't pay off
+
+/*
+ * Predicted size of the deep search tree of a solve, node counts are expected values and can be off by an order
+ * of magnitude on seeds with very uneven subtrees. The actual solve usually finds better bounds on the way and
+ * visits fewer nodes, the estimate is for the bound it starts with.
+ */
+struct TreeEstimate
+{
+    uint32_t seed          = 0;
+    uint32_t bound         = IMPOSSIBLE_SCORE;
+    bool heuristicRoute    = false; // the bound is a heuristic route shorter than the depth, a deep solve finds it
+    uint32_t routeAdvances = 0;     // leading CATCH_UPs of that route
+    double nodesPerSecond  = 0;
+    std::vector<double> advanceNodes;            // nodes below the root of each advance
+    std::vector<std::vector<double>> levelNodes; // [advance][level below its root]
+
+    [[nodiscard]] double getNodes(uint32_t advances) const; // the advances 0 to the given one together
+    [[nodiscard]] std::chrono::milliseconds getRuntime(uint32_t advances) const;
+};
+
+/*
+ * Estimates the tree with Knuth's method: random walks from the root of every advance, each level counting the
+ * product of the branching factors along the walk. The bound is settings.score, or the best of a short heuristic
+ * run if there is none. Also times a frontier expansion for the node rate of this machine.
+ */
+TreeEstimate estimateTree(const SolveSettings& settings);
+
+/*
+ * Picks the settings that minimise the expected wall time of the solve: the chunk depth whose frontier stays below
+ * AUTO_FRONTIER_TARGET, deep solving only below the estimated bound when the tree is done too quickly for the
+ * helpers to matter and, with a time limit, only as many advances as can finish in it.
+ */
+SolveSettings autoTune(const SolveSettings& settings, const TreeEstimate& estimate);
+
+void printEstimate(const TreeEstimate& estimate, std::ostream& out);
+void printTuning(const SolveSettings& settings, std::ostream& out);
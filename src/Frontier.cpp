@@ -0,0 +1,188 @@
+#include "Frontier.hpp"
+
+#include "Parallel.hpp"
+
+#include <algorithm>
+
+/*
+ * Frontier::Level implementation
+ */
+
+template<typename Costs>
+size_t Frontier<Costs>::Level::size() const
+{
+    return rngStates.size();
+}
+
+template<typename Costs>
+void Frontier<Costs>::Level::resize(size_t size)
+{
+    rngStates.resize(size);
+    shopFields.resize(size);
+    scores.resize(size);
+    bounds.resize(size);
+    parents.resize(size);
+    inputs.resize(size);
+}
+
+template<typename Costs>
+void Frontier<Costs>::Level::push(const MonochromeShop& shop,
+                                  uint32_t score,
+                                  uint32_t parent,
+                                  Input input,
+                                  const RngLookahead* lookahead)
+{
+    rngStates.push_back(shop.getRngState());
+    shopFields.push_back(shop.getPackedFields());
+    scores.push_back(score);
+    bounds.push_back(FullSolveEntry<Costs>::getBestPossibleScore(shop, score, lookahead));
+    parents.push_back(parent);
+    inputs.push_back(input);
+}
+
+template<typename Costs>
+void Frontier<Costs>::Level::copyFrom(const Level& other, size_t offset)
+{
+    std::copy(other.rngStates.begin(), other.rngStates.end(), rngStates.begin() + offset);
+    std::copy(other.shopFields.begin(), other.shopFields.end(), shopFields.begin() + offset);
+    std::copy(other.scores.begin(), other.scores.end(), scores.begin() + offset);
+    std::copy(other.bounds.begin(), other.bounds.end(), bounds.begin() + offset);
+    std::copy(other.parents.begin(), other.parents.end(), parents.begin() + offset);
+    std::copy(other.inputs.begin(), other.inputs.end(), inputs.begin() + offset);
+}
+
+/*
+ * Frontier implementation
+ */
+
+template<typename Costs>
+Frontier<Costs>::Frontier(const FullSolveEntry<Costs>& root)
+    : root(root)
+    , initialSeed(root.getShop().getInitialSeed())
+{
+    Level level;
+    level.push(root.getShop(), root.getScore(), 0, Input::CATCH_UP, root.getLookahead());
+    levels.push_back(std::move(level));
+}
+
+template<typename Costs>
+void Frontier<Costs>::expandNode(size_t index, Level& output, BestResult& best_result) const
+{
+    // mirrors FullSolveEntry::next
+    const Level& level = levels.back();
+    MonochromeShop shop(initialSeed, level.rngStates[index], level.shopFields[index]);
+    uint32_t score = level.scores[index];
+
+    if (shop.hasEnded())
+    {
+        if (shop.getProfits() >= REQUIRED_PROFITS && score < best_result.getCachedScore())
+            best_result.updateScore(materialize(levels.size() - 1, index));
+
+        return;
+    }
+
+    if (level.bounds[index] >= best_result.getCachedScore()) return;
+
+    auto addChild = [&](Input input)
+    {
+        MonochromeShop child = shop;
+        SolveSequenceResult res;
+        res.input    = input;
+        res.customer = shop.getCustomer().type;
+        res.item     = shop.getCustomer().item;
+        res.result   = child.input(input);
+
+        output.push(child, score + res.getScore(Costs::get()), index, input, root.getLookahead());
+        return res.result;
+    };
+
+    addChild(Input::RAISE_CANCEL);
+    addChild(Input::NORMAL);
+
+    // if raise results in a buy, then a lower will also guarantee a buy
+    auto result = addChild(Input::RAISE);
+    if (result != InputResult::BUY && result != InputResult::BUY_ENDED) addChild(Input::LOWER);
+}
+
+template<typename Costs>
+void Frontier<Costs>::expand(BestResult& best_result)
+{
+    const size_t count  = levels.back().size();
+    const size_t chunks = getChunkCount(count);
+
+    // a stopped solve gets a truncated level, nobody is going to look at it anymore
+    auto expandRange = [&](size_t first, size_t last, Level& output)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            if (i % FRONTIER_STOP_INTERVAL == 0 && best_result.isStopped()) return;
+            expandNode(i, output, best_result);
+        }
+    };
+
+    if (chunks == 1)
+    {
+        Level next;
+        expandRange(0, count, next);
+
+        levels.push_back(std::move(next));
+        return;
+    }
+
+    std::vector<Level> outputs(chunks);
+    parallelFor(chunks,
+                [&](size_t chunk)
+                {
+                    auto [first, last] = getChunkRange(count, chunks, chunk);
+                    expandRange(first, last, outputs[chunk]);
+                });
+
+    // compact the chunk outputs, each one lands at the prefix sum of the sizes before it
+    std::vector<size_t> offsets(chunks + 1, 0);
+    for (size_t i = 0; i < chunks; i++)
+        offsets[i + 1] = offsets[i] + outputs[i].size();
+
+    Level next;
+    next.resize(offsets.back());
+    parallelFor(chunks, [&](size_t chunk) { next.copyFrom(outputs[chunk], offsets[chunk]); });
+
+    levels.push_back(std::move(next));
+}
+
+template<typename Costs>
+size_t Frontier<Costs>::size() const
+{
+    return levels.back().size();
+}
+
+template<typename Costs>
+std::vector<uint32_t> Frontier<Costs>::sortByBound() const
+{
+    return parallelRadixSort(levels.back().bounds);
+}
+
+template<typename Costs>
+FullSolveEntry<Costs> Frontier<Costs>::materialize(size_t index) const
+{
+    return materialize(levels.size() - 1, index);
+}
+
+template<typename Costs>
+FullSolveEntry<Costs> Frontier<Costs>::materialize(size_t level, size_t index) const
+{
+    std::vector<Input> path;
+    for (; level > 0; level--)
+    {
+        path.push_back(levels[level].inputs[index]);
+        index = levels[level].parents[index];
+    }
+
+    FullSolveEntry<Costs> entry = root;
+    for (auto it = path.rbegin(); it != path.rend(); it++)
+        entry.apply(*it);
+
+    return entry;
+}
+
+template class Frontier<DefaultCosts>;
+template class Frontier<DynamicCosts>;
@@ -0,0 +1,55 @@
+#pragma once
+#include "FullSolver.hpp"
+#include "MonochromeShop.hpp"
+
+#include <cstdint>
+#include <vector>
+
+constexpr size_t FRONTIER_STOP_INTERVAL = 1024; // nodes between checking whether the solve got stopped
+
+/*
+ * Breadth-first expansion of a FullSolveEntry, stored as one set of parallel arrays per level.
+ * Nodes only remember their parent and input, full entries get rebuilt on demand by replaying them from the root.
+ * Big levels are expanded in parallel chunks, which are compacted into the next level afterwards.
+ */
+template<typename Costs>
+class Frontier
+{
+private:
+    struct Level
+    {
+        std::vector<uint32_t> rngStates;
+        std::vector<uint32_t> shopFields;
+        std::vector<uint32_t> scores;
+        std::vector<uint32_t> bounds;
+        std::vector<uint32_t> parents;
+        std::vector<Input> inputs;
+
+        size_t size() const;
+        void resize(size_t size);
+        void push(const MonochromeShop& shop,
+                  uint32_t score,
+                  uint32_t parent,
+                  Input input,
+                  const RngLookahead* lookahead);
+        void copyFrom(const Level& other, size_t offset);
+    };
+
+    FullSolveEntry<Costs> root;
+    uint32_t initialSeed;
+    std::vector<Level> levels;
+
+    void expandNode(size_t index, Level& output, BestResult& best_result) const;
+    FullSolveEntry<Costs> materialize(size_t level, size_t index) const;
+
+public:
+    explicit Frontier(const FullSolveEntry<Costs>& root);
+
+    void expand(BestResult& best_result);
+    [[nodiscard]] size_t size() const; // nodes on the deepest level
+    [[nodiscard]] std::vector<uint32_t> sortByBound() const;
+    [[nodiscard]] FullSolveEntry<Costs> materialize(size_t index) const;
+};
+
+extern template class Frontier<DefaultCosts>;
+extern template class Frontier<DynamicCosts>;
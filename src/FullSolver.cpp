@@ -1,28 +1,46 @@
 #include "FullSolver.hpp"
 
 #include "MonochromeShop.hpp"
+#include "Trace.hpp"
 
-#include <iostream>
+#include <algorithm>
 
 constexpr int32_t ceilDiv(int32_t val1, int32_t val2)
 {
     return (val1 + val2 - 1) / val2;
 }
 
+namespace
+{
+    /*
+     * Per-thread copy of the best score, re-read from the shared atomic every BOUND_REFRESH_INTERVAL calls.
+     * A stale value is never lower than the real one, so it only costs some pruning, never correctness.
+     */
+    struct BoundCache
+    {
+        uint64_t owner     = 0;
+        uint32_t score     = IMPOSSIBLE_SCORE;
+        uint32_t countdown = 0;
+    };
+
+    thread_local BoundCache boundCache;
+    std::atomic_uint64_t nextResultId = 1;
+} // namespace
+
 /*
  * SolveSequenceResult implementation
  */
 
-uint32_t SolveSequenceResult::getScore() const
+uint32_t SolveSequenceResult::getScore(const CostProfile& costs) const
 {
     uint32_t score = 0;
     switch (input)
     {
-        case Input::RAISE: score += RAISE_COST; break;
-        case Input::NORMAL: score += NORMAL_COST; break;
-        case Input::LOWER: score += LOWER_COST; break;
-        case Input::RAISE_CANCEL: score += CANCEL_COST; break;
-        case Input::CATCH_UP: score += ADVANCE_COST; break;
+        case Input::RAISE: score += costs.raise; break;
+        case Input::NORMAL: score += costs.normal; break;
+        case Input::LOWER: score += costs.lower; break;
+        case Input::RAISE_CANCEL: score += costs.cancel; break;
+        case Input::CATCH_UP: score += costs.advance; break;
         default: break;
     }
 
@@ -31,24 +49,24 @@ uint32_t SolveSequenceResult::getScore() const
         case InputResult::ADVANCE: break;
         case InputResult::BUY:       // fall-through
         case InputResult::BUY_ENDED: // fall-through
-            if (item == Item::MEDICINE && customer == CustomerType::MUCHOMON) score -= NON_MUCHO_MEDICINE_COST;
+            if (item == Item::MEDICINE && customer == CustomerType::MUCHOMON) score -= costs.nonMuchoMedicine;
             // conditional fall-though
         case InputResult::LEAVE: // fall-through
         case InputResult::LEAVE_ENDED:
-            score += NON_MUCHO_MEDICINE_COST;
-            if (item == Item::MEAT) score += MEAT_COST;
-            score += STATIC_COST;
+            score += costs.nonMuchoMedicine;
+            if (item == Item::MEAT) score += costs.meat;
+            score += costs.staticCost;
             switch (customer)
             {
-                case CustomerType::MUCHOMON: score += MUCHOMON_WALK_COST; break;
-                case CustomerType::GOBURIMON: score += GOBURIMON_WALK_COST; break;
-                case CustomerType::GOTSUMON: score += GOTSUMON_WALK_COST; break;
-                case CustomerType::WEEDMON: score += WEEDMON_WALK_COST; break;
+                case CustomerType::MUCHOMON: score += costs.muchomonWalk; break;
+                case CustomerType::GOBURIMON: score += costs.goburimonWalk; break;
+                case CustomerType::GOTSUMON: score += costs.gotsumonWalk; break;
+                case CustomerType::WEEDMON: score += costs.weedmonWalk; break;
                 default: break;
             }
             break;
         case InputResult::CANCEL: break;
-        case InputResult::DENY: score += DENY_COST; break;
+        case InputResult::DENY: score += costs.deny; break;
     }
 
     return score;
@@ -58,7 +76,7 @@ uint32_t SolveSequenceResult::getScore() const
  * ISolveEntry implementation
  */
 
-ISolveEntry::ISolveEntry(uint32_t seed, uint32_t advances)
+ISolveEntry::ISolveEntry(uint32_t seed, uint32_t advances, const CostProfile& costs)
     : shop(seed, advances)
 {
     for (uint32_t i = 0; i < advances; i++)
@@ -69,7 +87,7 @@ ISolveEntry::ISolveEntry(uint32_t seed, uint32_t advances)
             .input    = Input::CATCH_UP,
             .result   = InputResult::ADVANCE,
         };
-        currentScore += ADVANCE_COST;
+        currentScore += costs.advance;
         inputs.push_back(res);
     }
 }
@@ -94,6 +112,11 @@ MonochromeShop ISolveEntry::getShop() const
     return shop;
 }
 
+bool ISolveEntry::hasSameInputs(const ISolveEntry& other) const
+{
+    return shop.getInitialSeed() == other.shop.getInitialSeed() && inputs == other.inputs;
+}
+
 bool ISolveEntry::operator<(const ISolveEntry& other) const
 {
     return best_possible_score < other.best_possible_score;
@@ -103,49 +126,92 @@ bool ISolveEntry::operator<(const ISolveEntry& other) const
  * FullSolveEntry implementation
  */
 
-uint32_t FullSolveEntry::getBestPossibleScore() const
+template<typename Costs>
+const RngLookahead* FullSolveEntry<Costs>::getLookahead() const
 {
-    constexpr int32_t BUY_COST    = STATIC_COST + MUCHOMON_WALK_COST + RAISE_COST;
-    constexpr int32_t LEAVE_COST  = STATIC_COST + WEEDMON_WALK_COST + RAISE_COST + NON_MUCHO_MEDICINE_COST;
+    return lookahead;
+}
+
+template<typename Costs>
+uint32_t FullSolveEntry<Costs>::getBestPossibleScore() const
+{
+    return best_possible_score;
+}
+
+template<typename Costs>
+uint32_t FullSolveEntry<Costs>::getBestPossibleScore(const MonochromeShop& shop,
+                                                     uint32_t currentScore,
+                                                     const RngLookahead* lookahead)
+{
+    const auto& costs = Costs::get();
+    const auto walks  = { costs.goburimonWalk, costs.gotsumonWalk, costs.weedmonWalk, costs.muchomonWalk };
+
+    // cheapest buy and leave under the profile, for the default one that's Muchomon medicine and Weedmon
+    const int32_t MIN_INPUT  = std::min({ costs.raise, costs.normal, costs.lower });
+    const int32_t MIN_WALK   = std::min(walks);
+    const int32_t MIN_BUY    = std::min<int32_t>(costs.muchomonWalk, MIN_WALK + costs.nonMuchoMedicine);
+    const int32_t BUY_COST   = costs.staticCost + MIN_BUY + MIN_INPUT;
+    const int32_t LEAVE_COST = costs.staticCost + MIN_WALK + costs.nonMuchoMedicine + MIN_INPUT;
     constexpr auto MAXIMUM_PROFIT = 800;
 
-    uint32_t currentScore = getScore();
     if (shop.hasEnded()) return currentScore;
 
     int32_t remainingProfit    = REQUIRED_PROFITS - shop.getProfits();
     int32_t remainingCustomers = shop.getRemainingCustomers() + 1;
-    int32_t maxProfit          = getProfit(shop.getCustomer().item, Offer::PLUS_50);
-    auto minMedicine           = ceilDiv(remainingProfit, MAXIMUM_PROFIT);
+    auto minBuys               = ceilDiv(remainingProfit, MAXIMUM_PROFIT);
+
+    // the upcoming draws might not allow for that many medicine customers, which only matters with little slack
+    if (lookahead && remainingCustomers - minBuys <= LOOKAHEAD_SLACK)
+        minBuys = std::max(minBuys, lookahead->getMinimumBuys(shop, remainingProfit));
 
     // we can't get enough profit anymore -> dead path
-    if (minMedicine > remainingCustomers) return IMPOSSIBLE_SCORE;
+    if (minBuys > remainingCustomers) return IMPOSSIBLE_SCORE;
+
+    // a leave takes up two customers, if that's more expensive than two buys every customer might as well buy
+    if (BUY_COST * 2 < LEAVE_COST) minBuys = remainingCustomers;
 
-    remainingCustomers -= minMedicine;
+    remainingCustomers -= minBuys;
     uint32_t newScore = currentScore;
     newScore += (remainingCustomers / 2) * LEAVE_COST;
-    newScore += (minMedicine + remainingCustomers % 2) * BUY_COST;
+    newScore += (minBuys + remainingCustomers % 2) * BUY_COST;
 
     return newScore;
 }
 
-FullSolveEntry::FullSolveEntry(uint32_t seed, uint32_t advances)
-    : ISolveEntry(seed, advances)
+template<typename Costs>
+FullSolveEntry<Costs>::FullSolveEntry(uint32_t seed, uint32_t advances, const RngLookahead* lookahead)
+    : ISolveEntry(seed, advances, Costs::get())
+    , lookahead(lookahead)
 {
-    best_possible_score = getBestPossibleScore();
+    best_possible_score = getBestPossibleScore(shop, currentScore, lookahead);
 }
 
-FullSolveEntry::FullSolveEntry(const FullSolveEntry& previous, Input input)
+template<typename Costs>
+FullSolveEntry<Costs>::FullSolveEntry(const FullSolveEntry& previous, Input input)
     : ISolveEntry(previous)
 {
-    SolveSequenceResult res;
-    res.input    = input;
-    res.customer = shop.getCustomer().type;
-    res.item     = shop.getCustomer().item;
-    res.result   = shop.input(input);
+    apply(input);
+}
 
-    currentScore += res.getScore();
+template<typename Costs>
+FullSolveEntry<Costs>::FullSolveEntry(const FullSolveEntry& previous,
+                                      const SolveSequenceResult& step,
+                                      const MonochromeShop& shop,
+                                      uint32_t score,
+                                      uint32_t bound)
+    : ISolveEntry(previous)
+    , lookahead(previous.lookahead)
+{
+    this->shop          = shop;
+    currentScore        = score;
+    best_possible_score = bound;
+    push(step);
+}
 
-    switch (res.result)
+template<typename Costs>
+void FullSolveEntry<Costs>::push(const SolveSequenceResult& step)
+{
+    switch (step.result)
     {
         case InputResult::BUY_ENDED:
         case InputResult::LEAVE_ENDED:
@@ -153,21 +219,35 @@ FullSolveEntry::FullSolveEntry(const FullSolveEntry& previous, Input input)
         case InputResult::LEAVE: customerCount++; break;
         default: break;
     }
-    inputs.push_back(res);
-    best_possible_score = getBestPossibleScore();
+    inputs.push_back(step);
 }
 
-std::vector<FullSolveEntry> FullSolveEntry::next(BestResult& best_result) const
+template<typename Costs>
+void FullSolveEntry<Costs>::apply(Input input)
+{
+    SolveSequenceResult res;
+    res.input    = input;
+    res.customer = shop.getCustomer().type;
+    res.item     = shop.getCustomer().item;
+    res.result   = shop.input(input);
+
+    currentScore += res.getScore(Costs::get());
+    push(res);
+    best_possible_score = getBestPossibleScore(shop, currentScore, lookahead);
+}
+
+template<typename Costs>
+std::vector<FullSolveEntry<Costs>> FullSolveEntry<Costs>::next(BestResult& best_result) const
 {
     if (shop.hasEnded())
     {
-        if (shop.getProfits() >= REQUIRED_PROFITS && currentScore < best_result.getScore())
+        if (shop.getProfits() >= REQUIRED_PROFITS && currentScore < best_result.getCachedScore())
             best_result.updateScore(*this);
 
         return {};
     }
 
-    if (best_possible_score >= best_result.getScore()) { return {}; }
+    if (best_possible_score >= best_result.getCachedScore()) { return {}; }
 
     std::vector<FullSolveEntry> entries;
 
@@ -182,11 +262,79 @@ std::vector<FullSolveEntry> FullSolveEntry::next(BestResult& best_result) const
     return entries;
 }
 
+/*
+ * FullSolveEntry::Children implementation
+ */
+
+template<typename Costs>
+FullSolveEntry<Costs>::Children::Children(const FullSolveEntry& parent, BestResult& best_result)
+    : parent(&parent)
+{
+    // mirrors FullSolveEntry::next
+    auto& shop = parent.shop;
+    if (shop.hasEnded())
+    {
+        if (shop.getProfits() >= REQUIRED_PROFITS && parent.currentScore < best_result.getCachedScore())
+            best_result.updateScore(parent);
+
+        return;
+    }
+
+    if (parent.best_possible_score >= best_result.getCachedScore()) return;
+
+    add(shop, Input::RAISE_CANCEL);
+    add(shop, Input::NORMAL);
+    add(shop, Input::RAISE);
+
+    // if raise results in a buy, then a lower will also guarantee a buy
+    auto result = children[count - 1].step.result;
+    if (result != InputResult::BUY && result != InputResult::BUY_ENDED) add(shop, Input::LOWER);
+
+    // insertion sort, stable like the frontier's so both visit equal bounds in input order
+    for (uint32_t i = 1; i < count; i++)
+    {
+        for (uint32_t j = i; j > 0 && children[j].bound < children[j - 1].bound; j--)
+            std::swap(children[j], children[j - 1]);
+    }
+}
+
+template<typename Costs>
+void FullSolveEntry<Costs>::Children::add(const MonochromeShop& shop, Input input)
+{
+    MonochromeShop child = shop;
+    SolveSequenceResult step;
+    step.input    = input;
+    step.customer = shop.getCustomer().type;
+    step.item     = shop.getCustomer().item;
+    step.result   = child.input(input);
+
+    uint32_t score    = parent->currentScore + step.getScore(Costs::get());
+    children[count++] = {
+        .rngState   = child.getRngState(),
+        .shopFields = child.getPackedFields(),
+        .score      = score,
+        .bound      = getBestPossibleScore(child, score, parent->lookahead),
+        .step       = step,
+    };
+}
+
+template<typename Costs>
+std::optional<FullSolveEntry<Costs>> FullSolveEntry<Costs>::Children::next(const BestResult& best_result)
+{
+    // sorted by bound, a pruned child means all the ones after it are as well
+    if (position == count || children[position].bound >= best_result.getCachedScore()) return std::nullopt;
+
+    auto& child = children[position++];
+    MonochromeShop shop(parent->shop.getInitialSeed(), child.rngState, child.shopFields);
+    return FullSolveEntry(*parent, child.step, shop, child.score, child.bound);
+}
+
 /*
  * HeuristicSolveEntry implementation
  */
 
-Input HeuristicSolveEntry::rollInput()
+template<typename Costs>
+Input HeuristicSolveEntry<Costs>::rollInput()
 {
     uint32_t roll = rng() % 100;
     if (roll < 60)
@@ -199,12 +347,15 @@ Input HeuristicSolveEntry::rollInput()
         return Input::LOWER;
 }
 
-HeuristicSolveEntry::HeuristicSolveEntry(uint32_t seed, uint32_t advances)
-    : ISolveEntry(seed, advances)
+template<typename Costs>
+HeuristicSolveEntry<Costs>::HeuristicSolveEntry(uint32_t seed, uint32_t advances)
+    : ISolveEntry(seed, advances, Costs::get())
     , rng(std::chrono::high_resolution_clock::now().time_since_epoch().count())
 {
 }
-void HeuristicSolveEntry::next(BestResult& best_result)
+
+template<typename Costs>
+void HeuristicSolveEntry<Costs>::next(BestResult& best_result)
 {
     while (!shop.hasEnded())
     {
@@ -213,7 +364,7 @@ void HeuristicSolveEntry::next(BestResult& best_result)
         result.customer = shop.getCustomer().type;
         result.input    = rollInput();
         result.result   = shop.input(result.input);
-        currentScore += result.getScore();
+        currentScore += result.getScore(Costs::get());
 
         switch (result.result)
         {
@@ -229,31 +380,116 @@ void HeuristicSolveEntry::next(BestResult& best_result)
     if (shop.getProfits() >= REQUIRED_PROFITS && currentScore < best_result.getScore()) best_result.updateScore(*this);
 }
 
+template struct HeuristicSolveEntry<DefaultCosts>;
+template struct HeuristicSolveEntry<DynamicCosts>;
+template struct FullSolveEntry<DefaultCosts>;
+template struct FullSolveEntry<DynamicCosts>;
+
 /*
  * BestResult implementation
  */
 
-BestResult::BestResult(uint32_t initScore)
-    : score(initScore)
+BestResult::BestResult(uint32_t initScore, uint32_t capacity, std::stop_token stopToken)
+    : id(nextResultId++)
+    , initialScore(initScore)
+    , capacity(std::max(capacity, 1U))
+    , score(initScore)
+    , stopToken(std::move(stopToken))
 {
 }
 
 BestResult::BestResult(const BestResult& other)
+    : id(nextResultId++)
+    , initialScore(other.initialScore)
+    , capacity(other.capacity)
+    , score(other.getScore())
+    , node(other.node.load())
+    , stopToken(other.stopToken)
+{
+    std::scoped_lock lock(other.rankedMutex);
+    ranked = other.ranked;
+}
+
+void BestResult::updateScore(const ISolveEntry& entry)
 {
-    score = other.getScore();
-    node  = other.getBest();
+    if (entry.getScore() >= score.load(std::memory_order_relaxed)) return;
+
+    TraceSpan span("updateScore", "score", entry.getScore());
+    if (capacity == 1)
+        publishSingle(entry);
+    else
+        publishRanked(entry);
 }
 
-void BestResult::updateScore(ISolveEntry entry)
+void BestResult::tighten(uint32_t bound)
 {
-    std::scoped_lock lock(nodeMutex);
+    // with more slots the bound is the worst kept result, which an outside score says nothing about
+    if (capacity != 1) return;
+
+    uint32_t oldScore = score.load(std::memory_order_relaxed);
+    while (bound < oldScore && !score.compare_exchange_weak(oldScore, bound))
+        ;
+}
 
+void BestResult::publishSingle(const ISolveEntry& entry)
+{
     uint32_t newScore = entry.getScore();
-    if (newScore >= score) return;
+    uint32_t oldScore = score.load(std::memory_order_relaxed);
+
+    do
+    {
+        if (newScore >= oldScore) return;
+    } while (!score.compare_exchange_weak(oldScore, newScore));
+
+    traceInstant("new best", "score", newScore);
+    if (boundCache.owner == id) boundCache.score = newScore;
+
+    // a better entry might have been published between winning the score and storing the snapshot
+    auto snapshot = std::make_shared<const ISolveEntry>(entry);
+    auto current  = node.load();
+    while (!current || current->getScore() > newScore)
+        if (node.compare_exchange_weak(current, snapshot)) break;
+
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void BestResult::publishRanked(const ISolveEntry& entry)
+{
+    constexpr auto byScore = [](const Snapshot& a, const Snapshot& b) { return a->getScore() < b->getScore(); };
+
+    // copy outside of the lock, the heap itself only ever moves pointers
+    auto snapshot = std::make_shared<const ISolveEntry>(entry);
+
+    std::unique_lock lock(rankedMutex, std::defer_lock);
+    {
+        TraceSpan wait("updateScore lock wait");
+        lock.lock();
+    }
+    if (snapshot->getScore() >= score) return;
+
+    // the heuristic solver regularly stumbles over the same route more than once
+    if (std::ranges::any_of(ranked, [&](const Snapshot& val) { return val->hasSameInputs(*snapshot); })) return;
+
+    ranked.push_back(snapshot);
+    std::ranges::push_heap(ranked, byScore);
+    if (ranked.size() > capacity)
+    {
+        std::ranges::pop_heap(ranked, byScore);
+        ranked.pop_back();
+    }
+
+    uint32_t newScore = ranked.size() == capacity ? ranked.front()->getScore() : initialScore;
+    score             = newScore;
+    if (boundCache.owner == id) boundCache.score = newScore;
+
+    auto best = node.load();
+    if (!best || best->getScore() > snapshot->getScore())
+    {
+        node = snapshot;
+        traceInstant("new best", "score", snapshot->getScore());
+    }
 
-    score = newScore;
-    node  = entry;
-    std::cout << "New best: " << score << "\n";
+    generation.fetch_add(1, std::memory_order_release);
 }
 
 uint32_t BestResult::getScore() const
@@ -261,7 +497,70 @@ uint32_t BestResult::getScore() const
     return score;
 }
 
+uint32_t BestResult::getCachedScore() const
+{
+    if (boundCache.owner != id || boundCache.countdown-- == 0)
+    {
+        if (boundCache.owner == id) visitedNodes.fetch_add(BOUND_REFRESH_INTERVAL, std::memory_order_relaxed);
+        boundCache = { id, score.load(std::memory_order_relaxed), BOUND_REFRESH_INTERVAL };
+    }
+
+    return boundCache.score;
+}
+
+uint32_t BestResult::getBestScore() const
+{
+    auto snapshot = node.load();
+    return snapshot ? snapshot->getScore() : initialScore;
+}
+
+uint32_t BestResult::getCapacity() const
+{
+    return capacity;
+}
+
+uint32_t BestResult::getGeneration() const
+{
+    return generation.load(std::memory_order_acquire);
+}
+
+uint64_t BestResult::getVisitedNodes() const
+{
+    return visitedNodes.load(std::memory_order_relaxed);
+}
+
+bool BestResult::isStopped() const
+{
+    return stopToken.stop_requested();
+}
+
 std::optional<ISolveEntry> BestResult::getBest() const
 {
-    return node;
+    auto snapshot = node.load();
+    if (!snapshot) return std::nullopt;
+
+    return *snapshot;
+}
+
+std::vector<ISolveEntry> BestResult::getResults() const
+{
+    std::vector<ISolveEntry> results;
+
+    if (capacity == 1)
+    {
+        if (auto best = getBest()) results.push_back(*best);
+        return results;
+    }
+
+    std::scoped_lock lock(rankedMutex);
+    for (auto& val : ranked)
+        results.push_back(*val);
+
+    std::ranges::stable_sort(results,
+                             [](const ISolveEntry& a, const ISolveEntry& b)
+                             {
+                                 if (a.getScore() != b.getScore()) return a.getScore() < b.getScore();
+                                 return a.getInputs().size() < b.getInputs().size();
+                             });
+    return results;
 }
@@ -1,32 +1,26 @@
 #pragma once
+#include "CostProfile.hpp"
 #include "MonochromeShop.hpp"
+#include "RngLookahead.hpp"
 
+#include <array>
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <random>
+#include <stop_token>
 #include <vector>
 
-constexpr uint32_t VERSION                 = 2;
-constexpr uint32_t RAISE_COST              = 12;
-constexpr uint32_t NORMAL_COST             = 17;
-constexpr uint32_t LOWER_COST              = 17;
-constexpr uint32_t CANCEL_COST             = 16;
-constexpr uint32_t STATIC_COST             = 100; // spawn + request + react + wait
-constexpr uint32_t DENY_COST               = 36;
-constexpr uint32_t MEAT_COST               = 10;
-constexpr uint32_t NON_MUCHO_MEDICINE_COST = 10;
-constexpr uint32_t ADVANCE_COST            = 20;
-constexpr uint32_t GOBURIMON_WALK_COST     = 82;
-constexpr uint32_t GOTSUMON_WALK_COST      = 73;
-constexpr uint32_t MUCHOMON_WALK_COST      = 71;
-constexpr uint32_t WEEDMON_WALK_COST       = 65;
-
-constexpr int32_t SOLVE_DEPTH      = 10;
+constexpr uint32_t VERSION = 2;
+
+constexpr int32_t SOLVE_DEPTH      = 10; // default levels a deep solver frame expands before recursing
 constexpr uint32_t DEFAULT_DEPTH   = 30;
 constexpr int32_t REQUIRED_PROFITS = 3072;
 constexpr int32_t IMPOSSIBLE_SCORE = 99999;
 
+constexpr uint32_t BOUND_REFRESH_INTERVAL = 1024; // nodes between re-reading the shared best score
+
 struct SolveSequenceResult
 {
     CustomerType customer;
@@ -34,7 +28,9 @@ struct SolveSequenceResult
     Input input;
     InputResult result;
 
-    uint32_t getScore() const;
+    uint32_t getScore(const CostProfile& costs = DEFAULT_COSTS) const;
+
+    bool operator==(const SolveSequenceResult& other) const = default;
 };
 
 struct ISolveEntry
@@ -47,31 +43,58 @@ protected:
     std::vector<SolveSequenceResult> inputs;
 
 public:
-    explicit ISolveEntry(uint32_t seed, uint32_t advances = 0);
+    explicit ISolveEntry(uint32_t seed, uint32_t advances = 0, const CostProfile& costs = DEFAULT_COSTS);
 
     [[nodiscard]] uint32_t getScore() const;
     [[nodiscard]] uint32_t getCustomerCount() const;
     [[nodiscard]] std::vector<SolveSequenceResult> getInputs() const;
     [[nodiscard]] MonochromeShop getShop() const;
+    [[nodiscard]] bool hasSameInputs(const ISolveEntry& other) const;
     [[nodiscard]] bool operator<(const ISolveEntry& other) const;
 };
 
+/*
+ * Keeps the best `capacity` results found so far. getScore() is the pruning bound, i.e. the score a new
+ * result has to beat: the worst kept score once all slots are filled, the initial score before that.
+ * Solvers working on it give up once its stop token is triggered.
+ */
 struct BestResult
 {
 private:
+    using Snapshot = std::shared_ptr<const ISolveEntry>;
+
+    uint64_t id;
+    uint32_t initialScore;
+    uint32_t capacity;
     std::atomic_uint32_t score;
-    std::optional<ISolveEntry> node;
-    std::mutex nodeMutex;
+    std::atomic_uint32_t generation = 0;
+    mutable std::atomic_uint64_t visitedNodes = 0;
+    std::atomic<Snapshot> node;
+    std::vector<Snapshot> ranked; // max-heap by score, only used for capacity > 1
+    mutable std::mutex rankedMutex;
+    std::stop_token stopToken;
+
+    void publishSingle(const ISolveEntry& entry);
+    void publishRanked(const ISolveEntry& entry);
 
 public:
-    BestResult(uint32_t initScore = IMPOSSIBLE_SCORE);
+    BestResult(uint32_t initScore = IMPOSSIBLE_SCORE, uint32_t capacity = 1, std::stop_token stopToken = {});
     BestResult(const BestResult& other);
 
-    void updateScore(ISolveEntry entry);
+    void updateScore(const ISolveEntry& entry);
+    void tighten(uint32_t bound); // a score found elsewhere, e.g. by another process, only for a capacity of 1
     uint32_t getScore() const;
+    uint32_t getCachedScore() const;
+    uint32_t getBestScore() const;
+    uint32_t getCapacity() const;
+    uint32_t getGeneration() const;
+    uint64_t getVisitedNodes() const; // deep solver nodes, counted in batches of BOUND_REFRESH_INTERVAL
+    bool isStopped() const;
     std::optional<ISolveEntry> getBest() const;
+    std::vector<ISolveEntry> getResults() const;
 };
 
+template<typename Costs>
 struct HeuristicSolveEntry : public ISolveEntry
 {
 private:
@@ -85,14 +108,68 @@ public:
     void next(BestResult& best_result);
 };
 
+template<typename Costs>
 struct FullSolveEntry : public ISolveEntry
 {
 private:
-    uint32_t getBestPossibleScore() const;
+    const RngLookahead* lookahead = nullptr;
+
+    // a child whose shop and bound are already known, see Children
+    FullSolveEntry(const FullSolveEntry& previous,
+                   const SolveSequenceResult& step,
+                   const MonochromeShop& shop,
+                   uint32_t score,
+                   uint32_t bound);
+
+    void push(const SolveSequenceResult& step);
 
 public:
-    FullSolveEntry(uint32_t seed, uint32_t advances = 0);
+    /*
+     * The children of an entry in order of their bound, built lazily. Only their shops get simulated up front,
+     * the full entry with its copy of the inputs is built once a child is visited. As soon as the bound of the next
+     * child is no better than the result, that one and all after it are pruned without ever being built.
+     * Makes the same checks as FullSolveEntry::next, an ended or pruned entry has no children.
+     */
+    class Children
+    {
+    private:
+        struct Child
+        {
+            uint32_t rngState;
+            uint32_t shopFields;
+            uint32_t score;
+            uint32_t bound;
+            SolveSequenceResult step;
+        };
+
+        const FullSolveEntry* parent;
+        std::array<Child, 4> children;
+        uint32_t count    = 0;
+        uint32_t position = 0;
+
+        void add(const MonochromeShop& shop, Input input);
+
+    public:
+        Children(const FullSolveEntry& parent, BestResult& best_result);
+
+        // the next child that can still beat the result, none once the rest is pruned
+        std::optional<FullSolveEntry> next(const BestResult& best_result);
+    };
+
+    FullSolveEntry(uint32_t seed, uint32_t advances = 0, const RngLookahead* lookahead = nullptr);
     FullSolveEntry(const FullSolveEntry& previous, Input input);
 
+    void apply(Input input);
+    [[nodiscard]] const RngLookahead* getLookahead() const;
+    [[nodiscard]] uint32_t getBestPossibleScore() const;
+    static uint32_t getBestPossibleScore(const MonochromeShop& shop,
+                                         uint32_t currentScore,
+                                         const RngLookahead* lookahead = nullptr);
+
     std::vector<FullSolveEntry> next(BestResult& best_result) const;
-};
\ No newline at end of file
+};
+
+extern template struct HeuristicSolveEntry<DefaultCosts>;
+extern template struct HeuristicSolveEntry<DynamicCosts>;
+extern template struct FullSolveEntry<DefaultCosts>;
+extern template struct FullSolveEntry<DynamicCosts>;
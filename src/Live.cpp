@@ -0,0 +1,234 @@
+#include "Live.hpp"
+
+#include "DW1Random.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono;
+
+    class LiveSolver
+    {
+    private:
+        struct Answer
+        {
+            uint32_t state;
+            std::vector<ISolveEntry> results;
+        };
+
+        SolveSettings settings;
+        milliseconds budget;
+        SolveCache cache;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::list<Answer> answers; // most recently used first
+        std::optional<uint32_t> origin;
+        std::optional<uint32_t> speculating;
+        std::stop_source speculationStop;
+        bool busy     = false; // a state is being answered, the speculation waits for it
+        bool handover = false; // the current speculation is the answer to the state being asked for
+        bool quit     = false;
+        std::thread speculator;
+
+        const Answer* find(uint32_t state, bool use);
+        void store(uint32_t state, const std::vector<ISolveEntry>& results);
+        std::optional<uint32_t> nextSpeculation();
+        void speculate();
+
+    public:
+        LiveSolver(const SolveSettings& settings, milliseconds budget)
+            : settings(settings)
+            , budget(budget)
+        {
+            speculator = std::thread(&LiveSolver::speculate, this);
+        }
+
+        ~LiveSolver()
+        {
+            {
+                std::scoped_lock lock(mutex);
+                quit = true;
+                speculationStop.request_stop();
+            }
+            changed.notify_all();
+            speculator.join();
+        }
+
+        std::vector<ISolveEntry> answer(uint32_t state);
+    };
+
+    const LiveSolver::Answer* LiveSolver::find(uint32_t state, bool use)
+    {
+        auto it = std::ranges::find(answers, state, &Answer::state);
+        if (it == answers.end()) return nullptr;
+
+        if (use) answers.splice(answers.begin(), answers, it);
+        return &*it;
+    }
+
+    void LiveSolver::store(uint32_t state, const std::vector<ISolveEntry>& results)
+    {
+        if (find(state, true)) return;
+
+        answers.push_front({ state, results });
+        if (answers.size() > LIVE_CACHE_SIZE) answers.pop_back();
+    }
+
+    // the closest state after the last one asked for that has no answer yet
+    std::optional<uint32_t> LiveSolver::nextSpeculation()
+    {
+        if (!origin) return std::nullopt;
+
+        DW1Random rng(*origin);
+        for (uint32_t i = 0; i < LIVE_LOOKAHEAD; i++)
+        {
+            rng.next();
+            if (!find(rng.getState(), false)) return rng.getState();
+        }
+
+        return std::nullopt;
+    }
+
+    void LiveSolver::speculate()
+    {
+        std::unique_lock lock(mutex);
+        while (!quit)
+        {
+            auto state = busy ? std::nullopt : nextSpeculation();
+            if (!state)
+            {
+                changed.wait(lock);
+                continue;
+            }
+
+            speculating     = state;
+            speculationStop = {};
+            auto token      = speculationStop.get_token();
+            lock.unlock();
+
+            SolveSettings speculation = settings;
+            speculation.seed          = *state;
+            speculation.timeLimit     = budget * LIVE_SPECULATION;
+            auto result               = solve(speculation, cache, nullptr, token);
+
+            lock.lock();
+            // cut short for another state it's worth nothing, it would only be a worse answer than a new solve
+            if (!token.stop_requested() || handover) store(*state, result.getResults());
+            speculating.reset();
+            changed.notify_all();
+        }
+    }
+
+    std::vector<ISolveEntry> LiveSolver::answer(uint32_t state)
+    {
+        auto start = steady_clock::now();
+
+        std::unique_lock lock(mutex);
+        origin = state;
+        busy   = true;
+
+        if (speculating == state)
+        {
+            // it already had a head start, take whatever it found once the budget is used up
+            if (!changed.wait_until(lock, start + budget, [&] { return speculating != state; }))
+            {
+                handover = true;
+                speculationStop.request_stop();
+                changed.wait(lock, [&] { return speculating != state; });
+                handover = false;
+            }
+        }
+        else if (speculating)
+        {
+            speculationStop.request_stop();
+            changed.wait(lock, [&] { return !speculating; });
+        }
+
+        std::vector<ISolveEntry> results;
+        if (auto found = find(state, true))
+            results = found->results;
+        else
+        {
+            lock.unlock();
+
+            SolveSettings request = settings;
+            request.seed          = state;
+            request.timeLimit     = std::max(budget - duration_cast<milliseconds>(steady_clock::now() - start),
+                                         milliseconds(1));
+            auto result           = solve(request, cache);
+
+            lock.lock();
+            results = result.getResults();
+            if (!result.isStopped()) store(state, results);
+        }
+
+        busy = false;
+        changed.notify_all();
+        return results;
+    }
+
+    // decimal or 0x hex, a leading zero is just padding and doesn't make it octal
+    std::optional<uint32_t> parseState(const std::string& line)
+    {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return std::nullopt;
+
+        std::string_view text(line.data() + first, line.find_last_not_of(" \t\r") + 1 - first);
+        int base = 10;
+        if (text.starts_with("0x") || text.starts_with("0X"))
+        {
+            text.remove_prefix(2);
+            base = 16;
+        }
+
+        uint32_t value;
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+        if (error != std::errc() || end != text.data() + text.size()) return std::nullopt;
+
+        return value;
+    }
+} // namespace
+
+int live(std::istream& input, std::ostream& out, OutputFormat format, const SolveSettings& settings)
+{
+    auto budget = settings.timeLimit.count() > 0 ? settings.timeLimit : LIVE_DEFAULT_BUDGET;
+    LiveSolver solver(settings, budget);
+
+    std::string line;
+    while (!stop && std::getline(input, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        auto state = parseState(line);
+        if (!state)
+        {
+            std::cerr << "Invalid RNG state " << line << "\n";
+            continue;
+        }
+
+        auto start   = steady_clock::now();
+        auto results = solver.answer(*state);
+
+        SolveSettings answered = settings;
+        answered.seed          = *state;
+
+        auto output = createOutput(format, out, std::to_string(*state));
+        output->start(toParameters(answered));
+        output->finished(results, duration_cast<milliseconds>(steady_clock::now() - start));
+    }
+
+    return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "Output.hpp"
+#include "Solver.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+constexpr size_t LIVE_CACHE_SIZE    = 64; // answered or pre-solved states kept
+constexpr uint32_t LIVE_LOOKAHEAD   = 16; // states after the last one that get pre-solved
+constexpr uint32_t LIVE_SPECULATION = 10; // a pre-solve gets this many times the budget
+constexpr auto LIVE_DEFAULT_BUDGET  = std::chrono::milliseconds(1000);
+
+/*
+ * Answers every RNG state read from the input, one decimal or 0x hex number per line, with the best routes for it
+ * as seed. States are solved for at most the time limit of the settings, or LIVE_DEFAULT_BUDGET without one.
+ * While waiting for the next state the ones following the last along the LCG get solved ahead of time, those
+ * answers come out of a small LRU cache instantly. Runs until the end of the input, returns the exit code.
+ */
+int live(std::istream& input, std::ostream& out, OutputFormat format, const SolveSettings& settings);
@@ -0,0 +1,125 @@
+#include "MacroSolver.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace
+{
+    template<typename Costs>
+    void enumerateEdges(const MonochromeShop& start,
+                        const MonochromeShop& shop,
+                        std::vector<Input>& path,
+                        uint32_t cost,
+                        uint32_t fails,
+                        uint32_t cancels,
+                        MacroLimits limits,
+                        std::vector<MacroEdge>& edges)
+    {
+        auto tryInput = [&](Input input)
+        {
+            MonochromeShop child = shop;
+            SolveSequenceResult res;
+            res.input    = input;
+            res.customer = shop.getCustomer().type;
+            res.item     = shop.getCustomer().item;
+            res.result   = child.input(input);
+
+            uint32_t newCost = cost + res.getScore(Costs::get());
+            path.push_back(input);
+
+            switch (res.result)
+            {
+                case InputResult::CANCEL:
+                    enumerateEdges<Costs>(start, child, path, newCost, fails, cancels + 1, limits, edges);
+                    break;
+                case InputResult::DENY:
+                    if (fails < limits.fails)
+                        enumerateEdges<Costs>(start, child, path, newCost, fails + 1, cancels, limits, edges);
+                    break;
+                default:
+                    edges.push_back({
+                        .inputs    = path,
+                        .cost      = newCost,
+                        .profit    = child.getProfits() - start.getProfits(),
+                        .exitState = child.getRngState(),
+                        .bought    = res.result == InputResult::BUY || res.result == InputResult::BUY_ENDED,
+                    });
+                    break;
+            }
+
+            path.pop_back();
+            return res.result;
+        };
+
+        if (cancels < limits.cancels) tryInput(Input::RAISE_CANCEL);
+        tryInput(Input::NORMAL);
+
+        // if raise results in a buy, then a lower will also guarantee a buy
+        auto result = tryInput(Input::RAISE);
+        if (result != InputResult::BUY && result != InputResult::BUY_ENDED) tryInput(Input::LOWER);
+    }
+} // namespace
+
+template<typename Costs>
+MacroEdgeCache<Costs>::MacroEdgeCache(MacroLimits limits)
+    : limits(limits)
+{
+}
+
+template<typename Costs>
+MacroEdges MacroEdgeCache<Costs>::get(const MonochromeShop& shop)
+{
+    uint32_t key = shop.getRngState();
+    auto& shard  = shards[key % MACRO_CACHE_SHARDS];
+
+    {
+        std::scoped_lock lock(shard.mutex);
+        auto it = shard.edges.find(key);
+        if (it != shard.edges.end()) return it->second;
+    }
+
+    // enumerating outside of the lock means two threads might do the same work, but never block each other
+    auto edges = std::make_shared<const std::vector<MacroEdge>>(enumerate(shop, limits));
+
+    std::scoped_lock lock(shard.mutex);
+    if (shard.edges.size() >= MACRO_CACHE_SHARD_SIZE) shard.edges.clear();
+    shard.edges.emplace(key, edges);
+    return edges;
+}
+
+template<typename Costs>
+std::vector<MacroEdge> MacroEdgeCache<Costs>::enumerate(const MonochromeShop& shop, MacroLimits limits)
+{
+    // the edges must not depend on how many customers are left, so always start with a fresh one
+    auto start = MonochromeShop::atSpawn(shop.getRngState(), shop.getCustomer());
+
+    std::vector<Input> path;
+    std::vector<MacroEdge> edges;
+    enumerateEdges<Costs>(start, start, path, 0, 0, 0, limits, edges);
+
+    // an edge is dominated by one that leaves the same RNG state and customer count behind for less or equal
+    // cost and at least as much profit
+    std::ranges::sort(edges,
+                      [](const MacroEdge& a, const MacroEdge& b)
+                      {
+                          return std::tie(a.exitState, a.bought, a.cost, b.profit) <
+                                 std::tie(b.exitState, b.bought, b.cost, a.profit);
+                      });
+
+    std::vector<MacroEdge> undominated;
+    for (auto& edge : edges)
+    {
+        if (!undominated.empty())
+        {
+            auto& last = undominated.back();
+            if (last.exitState == edge.exitState && last.bought == edge.bought && last.profit >= edge.profit)
+                continue;
+        }
+        undominated.push_back(std::move(edge));
+    }
+
+    return undominated;
+}
+
+template class MacroEdgeCache<DefaultCosts>;
+template class MacroEdgeCache<DynamicCosts>;
@@ -0,0 +1,64 @@
+#pragma once
+#include "FullSolver.hpp"
+#include "MonochromeShop.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t DEFAULT_MACRO_FAILS   = 3;
+constexpr uint32_t DEFAULT_MACRO_CANCELS = 3;
+constexpr size_t MACRO_CACHE_SHARDS      = 64;
+constexpr size_t MACRO_CACHE_SHARD_SIZE  = 1 << 16; // spawn states per shard before it gets flushed
+
+struct MacroLimits
+{
+    uint32_t fails   = DEFAULT_MACRO_FAILS;   // DENYs per customer
+    uint32_t cancels = DEFAULT_MACRO_CANCELS; // CANCELs per customer
+
+    bool operator==(const MacroLimits& other) const = default;
+};
+
+/*
+ * One complete interaction with a customer, from its spawn until it buys or leaves.
+ */
+struct MacroEdge
+{
+    std::vector<Input> inputs;
+    uint32_t cost;
+    uint32_t profit;
+    uint32_t exitState; // RNG state after the next customer spawned
+    bool bought;
+};
+
+using MacroEdges = std::shared_ptr<const std::vector<MacroEdge>>;
+
+/*
+ * The undominated macro edges of every spawn state seen so far, shared by all threads of a solve.
+ * A spawn state fully determines the customer, so the RNG state after the spawn is enough as key.
+ */
+template<typename Costs>
+class MacroEdgeCache
+{
+private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, MacroEdges> edges;
+    };
+
+    MacroLimits limits;
+    std::array<Shard, MACRO_CACHE_SHARDS> shards;
+
+public:
+    explicit MacroEdgeCache(MacroLimits limits);
+
+    MacroEdges get(const MonochromeShop& shop);
+    static std::vector<MacroEdge> enumerate(const MonochromeShop& shop, MacroLimits limits);
+};
+
+extern template class MacroEdgeCache<DefaultCosts>;
+extern template class MacroEdgeCache<DynamicCosts>;
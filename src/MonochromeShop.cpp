@@ -1,6 +1,7 @@
 
 #include "MonochromeShop.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <tuple>
@@ -90,16 +91,6 @@ constexpr std::array<std::array<uint32_t, 9>, 3> profits = {
     },
 };
 
-constexpr uint32_t getLeaveChance(CustomerType type, uint32_t fails)
-{
-    return leaveChances[static_cast<int>(type)][std::min(fails, 2U)];
-}
-
-constexpr uint32_t getBuyChance(CustomerType customer, Item item, Offer offer)
-{
-    return takeChances[static_cast<int>(customer)][static_cast<int>(item)][static_cast<int>(offer)];
-}
-
 constexpr CustomerType getCustomerType(uint32_t roll)
 {
     if (roll <= 2)
@@ -112,7 +103,121 @@ constexpr CustomerType getCustomerType(uint32_t roll)
         return CustomerType::MUCHOMON;
 }
 
-constexpr Item getCustomerItem(CustomerType customer, uint32_t roll)
+/*
+ * Raw draw tables, generated from the data above.
+ * next(limit) < chance holds exactly when next() < ceil(chance * range / limit), so every chance check becomes
+ * one compare against the raw draw and every multi-way roll one table load.
+ */
+
+constexpr uint16_t toRawThreshold(uint32_t chance, uint32_t limit)
+{
+    return static_cast<uint16_t>((chance * DW1Random::range + limit - 1) / limit);
+}
+
+template<uint32_t Limit, size_t Size>
+constexpr std::array<uint16_t, Size> toRawThresholds(const std::array<uint32_t, Size>& chances)
+{
+    std::array<uint16_t, Size> result{};
+    for (size_t i = 0; i < Size; i++)
+        result[i] = toRawThreshold(chances[i], Limit);
+
+    return result;
+}
+
+template<uint32_t Limit, typename T, size_t Size>
+constexpr auto toRawThresholds(const std::array<T, Size>& chances)
+{
+    std::array<decltype(toRawThresholds<Limit>(chances[0])), Size> result{};
+    for (size_t i = 0; i < Size; i++)
+        result[i] = toRawThresholds<Limit>(chances[i]);
+
+    return result;
+}
+
+struct RawItemThresholds
+{
+    uint16_t portPotty;
+    uint16_t medicine;
+};
+
+struct RawDraw
+{
+    CustomerType type;
+    Offer raise;
+    Offer lower;
+};
+
+constexpr auto rawTakeChances  = toRawThresholds<100>(takeChances);
+constexpr auto rawLeaveChances = toRawThresholds<100>(leaveChances);
+
+constexpr auto rawItemChances = []
+{
+    std::array<RawItemThresholds, itemChances.size()> result{};
+    for (size_t i = 0; i < itemChances.size(); i++)
+    {
+        result[i].portPotty = toRawThreshold(itemChances[i].chanceMeat, 100);
+        result[i].medicine  = toRawThreshold(itemChances[i].chanceMeat + itemChances[i].chancePotty, 100);
+    }
+
+    return result;
+}();
+
+constexpr auto rawDraws = []
+{
+    std::array<RawDraw, DW1Random::range> result{};
+    for (uint32_t raw = 0; raw < DW1Random::range; raw++)
+    {
+        result[raw].type  = getCustomerType(DW1Random::scale(raw, 9));
+        result[raw].raise = static_cast<Offer>(DW1Random::scale(raw, 5));
+        result[raw].lower = static_cast<Offer>(static_cast<uint32_t>(Offer::MINUS_10) + DW1Random::scale(raw, 3));
+    }
+
+    return result;
+}();
+
+constexpr uint16_t getRawLeaveThreshold(CustomerType type, uint32_t fails)
+{
+    return rawLeaveChances[static_cast<int>(type)][std::min(fails, 2U)];
+}
+
+constexpr uint16_t getRawBuyThreshold(CustomerType customer, Item item, Offer offer)
+{
+    return rawTakeChances[static_cast<int>(customer)][static_cast<int>(item)][static_cast<int>(offer)];
+}
+
+constexpr Item getCustomerItem(CustomerType customer, uint16_t raw)
+{
+    auto& thresholds = rawItemChances[static_cast<int>(customer)];
+    return static_cast<Item>((raw >= thresholds.portPotty) + (raw >= thresholds.medicine));
+}
+
+uint32_t getProfit(Item item, Offer offer)
+{
+    return profits[static_cast<int>(item)][static_cast<int>(offer)];
+}
+
+Customer rollCustomer(DW1Random& rng)
+{
+    CustomerType type = rawDraws[rng.next()].type;
+    Item item         = getCustomerItem(type, rng.next());
+    return { type, item, 0 };
+}
+
+/*
+ * Reference rolls, the way the shop rolled before the raw draw tables
+ */
+
+constexpr uint32_t getReferenceLeaveChance(CustomerType type, uint32_t fails)
+{
+    return leaveChances[static_cast<int>(type)][std::min(fails, 2U)];
+}
+
+constexpr uint32_t getReferenceBuyChance(CustomerType customer, Item item, Offer offer)
+{
+    return takeChances[static_cast<int>(customer)][static_cast<int>(item)][static_cast<int>(offer)];
+}
+
+constexpr Item getReferenceCustomerItem(CustomerType customer, uint32_t roll)
 {
     auto& chances = itemChances[static_cast<int>(customer)];
 
@@ -124,11 +229,56 @@ constexpr Item getCustomerItem(CustomerType customer, uint32_t roll)
         return Item::MEDICINE;
 }
 
-uint32_t getProfit(Item item, Offer offer)
+bool checkRawDraw(uint16_t raw)
 {
-    return profits[static_cast<int>(item)][static_cast<int>(offer)];
+    // next(limit) is the raw draw scaled to the limit
+    auto roll = [raw](uint32_t limit) { return DW1Random::scale(raw, limit); };
+
+    auto& draw = rawDraws[raw];
+    if (draw.type != getCustomerType(roll(9))) return false;
+    if (draw.raise != static_cast<Offer>(roll(5))) return false;
+    if (draw.lower != static_cast<Offer>(static_cast<uint32_t>(Offer::MINUS_10) + roll(3))) return false;
+
+    for (uint32_t i = 0; i < takeChances.size(); i++)
+    {
+        auto type = static_cast<CustomerType>(i);
+        if (getCustomerItem(type, raw) != getReferenceCustomerItem(type, roll(100))) return false;
+
+        for (uint32_t fails = 0; fails <= 3; fails++)
+        {
+            if ((raw < getRawLeaveThreshold(type, fails)) != (roll(100) < getReferenceLeaveChance(type, fails)))
+                return false;
+        }
+
+        for (uint32_t j = 0; j < takeChances[i].size(); j++)
+        {
+            for (uint32_t k = 0; k < takeChances[i][j].size(); k++)
+            {
+                auto item   = static_cast<Item>(j);
+                auto offer  = static_cast<Offer>(k);
+                bool buys   = raw < getRawBuyThreshold(type, item, offer);
+                bool bought = roll(100) < getReferenceBuyChance(type, item, offer);
+                if (buys != bought) return false;
+            }
+        }
+    }
+
+    return true;
 }
 
+/*
+ * Packed state layout, everything but the RNG state and the initial seed in one 32 bit value.
+ * Fails saturate, as the game stops caring about them after the second one.
+ */
+
+constexpr uint32_t PACKED_PROFIT_SHIFT    = 0;  // 14 bit, at most 20 * 800
+constexpr uint32_t PACKED_REMAINING_SHIFT = 14; // 5 bit, stored +1 as it reaches -1 when the last customer leaves
+constexpr uint32_t PACKED_TYPE_SHIFT      = 19; // 3 bit
+constexpr uint32_t PACKED_ITEM_SHIFT      = 22; // 2 bit
+constexpr uint32_t PACKED_FAILS_SHIFT     = 24; // 7 bit
+constexpr uint32_t PACKED_ENDED_SHIFT     = 31; // 1 bit
+constexpr uint32_t PACKED_FAILS_MAX       = 0x7F;
+
 /*
  * MonochromeShop Public Methods
  */
@@ -148,6 +298,33 @@ MonochromeShop::MonochromeShop(uint32_t seed, uint32_t advances)
     nextCustomer();
 }
 
+MonochromeShop::MonochromeShop(uint32_t initialSeed, uint32_t rngState, uint32_t packedFields)
+    : initial_seed(initialSeed)
+    , rng(rngState)
+    , remainingCustomers(static_cast<int32_t>((packedFields >> PACKED_REMAINING_SHIFT) & 0x1F) - 1)
+    , profit((packedFields >> PACKED_PROFIT_SHIFT) & 0x3FFF)
+    , currentCustomer({
+          .type  = static_cast<CustomerType>((packedFields >> PACKED_TYPE_SHIFT) & 0x7),
+          .item  = static_cast<Item>((packedFields >> PACKED_ITEM_SHIFT) & 0x3),
+          .fails = (packedFields >> PACKED_FAILS_SHIFT) & PACKED_FAILS_MAX,
+      })
+    , ended((packedFields >> PACKED_ENDED_SHIFT) & 0x1)
+{
+}
+
+MonochromeShop MonochromeShop::atSpawn(uint32_t rngState, const Customer& customer)
+{
+    // all but the first customer still to come, like right after the initial spawn
+    constexpr uint32_t remaining = 19;
+
+    uint32_t fields = 0;
+    fields |= (remaining + 1) << PACKED_REMAINING_SHIFT;
+    fields |= static_cast<uint32_t>(customer.type) << PACKED_TYPE_SHIFT;
+    fields |= static_cast<uint32_t>(customer.item) << PACKED_ITEM_SHIFT;
+
+    return MonochromeShop(rngState, rngState, fields);
+}
+
 InputResult MonochromeShop::input(Input input)
 {
     Offer offer;
@@ -160,9 +337,9 @@ InputResult MonochromeShop::input(Input input)
         case Input::NORMAL_CANCEL:                          // fall-through
             return InputResult::CANCEL;
 
-        case Input::RAISE: offer = static_cast<Offer>(rng.next(5)); break;
+        case Input::RAISE: offer = rawDraws[rng.next()].raise; break;
         case Input::NORMAL: offer = Offer::NORMAL; break;
-        case Input::LOWER: offer = static_cast<Offer>(static_cast<int>(Offer::MINUS_10) + rng.next(3)); break;
+        case Input::LOWER: offer = rawDraws[rng.next()].lower; break;
     }
 
     Result result = makeOffer(offer);
@@ -222,29 +399,44 @@ uint32_t MonochromeShop::getInitialSeed() const
     return initial_seed;
 }
 
+uint32_t MonochromeShop::getRngState() const
+{
+    return rng.getState();
+}
+
+uint32_t MonochromeShop::getPackedFields() const
+{
+    uint32_t fields = 0;
+    fields |= profit << PACKED_PROFIT_SHIFT;
+    fields |= static_cast<uint32_t>(remainingCustomers + 1) << PACKED_REMAINING_SHIFT;
+    fields |= static_cast<uint32_t>(currentCustomer.type) << PACKED_TYPE_SHIFT;
+    fields |= static_cast<uint32_t>(currentCustomer.item) << PACKED_ITEM_SHIFT;
+    fields |= std::min(currentCustomer.fails, PACKED_FAILS_MAX) << PACKED_FAILS_SHIFT;
+    fields |= static_cast<uint32_t>(ended) << PACKED_ENDED_SHIFT;
+    return fields;
+}
+
 /*
  * MonochromeShop Private Methods
  */
 
 void MonochromeShop::nextCustomer()
 {
-    CustomerType type = getCustomerType(rng.next(9));
-    Item item         = getCustomerItem(type, rng.next(100));
+    currentCustomer = rollCustomer(rng);
     remainingCustomers--;
-    currentCustomer = { type, item, 0 };
 }
 
 Result MonochromeShop::makeOffer(Offer offer)
 {
-    uint32_t buyChance = getBuyChance(currentCustomer.type, currentCustomer.item, offer);
-    uint32_t buyRoll   = rng.next(100);
+    uint16_t buyThreshold = getRawBuyThreshold(currentCustomer.type, currentCustomer.item, offer);
+    uint16_t buyRoll      = rng.next();
 
-    if (buyRoll < buyChance) return Result::BUY;
+    if (buyRoll < buyThreshold) return Result::BUY;
 
-    uint32_t leaveChance = getLeaveChance(currentCustomer.type, currentCustomer.fails++);
-    uint32_t leaveRoll   = rng.next(100);
+    uint16_t leaveThreshold = getRawLeaveThreshold(currentCustomer.type, currentCustomer.fails++);
+    uint16_t leaveRoll      = rng.next();
 
-    if (leaveRoll < leaveChance) return Result::LEAVE;
+    if (leaveRoll < leaveThreshold) return Result::LEAVE;
 
     return Result::DENY;
 }
\ No newline at end of file
@@ -84,6 +84,9 @@ private:
 public:
     explicit MonochromeShop(DW1Random rng);
     explicit MonochromeShop(uint32_t seed, uint32_t advances = 0);
+    MonochromeShop(uint32_t initialSeed, uint32_t rngState, uint32_t packedFields);
+
+    static MonochromeShop atSpawn(uint32_t rngState, const Customer& customer);
 
     InputResult input(Input input);
 
@@ -92,6 +95,8 @@ public:
     uint32_t getProfits() const;
     uint32_t getRemainingCustomers() const;
     uint32_t getInitialSeed() const;
+    uint32_t getRngState() const;
+    uint32_t getPackedFields() const;
 
 private:
     void nextCustomer();
@@ -99,3 +104,10 @@ private:
 };
 
 uint32_t getProfit(Item item, Offer offer);
+Customer rollCustomer(DW1Random& rng);
+
+/*
+ * Whether every lookup of the raw draw tables for the given draw agrees with the next(limit) rolls against the chance
+ * arrays they were generated from, i.e. with the shop before the tables.
+ */
+bool checkRawDraw(uint16_t raw);
@@ -1,193 +1,32 @@
+#include "Cluster.hpp"
+#include "Estimator.hpp"
 #include "FullSolver.hpp"
+#include "Live.hpp"
+#include "MacroSolver.hpp"
 #include "MonochromeShop.hpp"
+#include "Output.hpp"
+#include "Server.hpp"
+#include "Solver.hpp"
+#include "Trace.hpp"
+#include "Verifier.hpp"
 
 #include <boost/program_options.hpp>
 #include <signal.h>
 #include <stdint.h>
 
-#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <csignal>
 #include <cstdint>
-#include <functional>
 #include <iostream>
 #include <optional>
-#include <thread>
-#include <vector>
-
-std::atomic_bool stop = false;
-
-enum class Mode
-{
-    DEEP,
-    HEURISTIC,
-    COMBINED,
-};
-
-/*
- * Enum -> String conversion helper
- */
-
-std::string convertInput(Input input)
-{
-    switch (input)
-    {
-        case Input::LOWER: return "LOWER";
-        case Input::LOWER_CANCEL: return "LOWER_CANCEL";
-        case Input::RAISE_CANCEL: return "RAISE_CANCEL";
-        case Input::RAISE: return "RAISE";
-        case Input::NORMAL_CANCEL: return "NORMAL_CANCEL";
-        case Input::NORMAL: return "NORMAL";
-        case Input::CATCH_UP: return "CATCH_UP";
-    }
-
-    return "SOMETHING BROKE";
-}
-
-std::string convertResult(InputResult result)
-{
-    switch (result)
-    {
-        case InputResult::BUY: return "BUY";
-        case InputResult::BUY_ENDED: return "BUY_ENDED";
-        case InputResult::LEAVE_ENDED: return "LEAVE_ENDED";
-        case InputResult::LEAVE: return "LEAVE";
-        case InputResult::DENY: return "DENY";
-        case InputResult::CANCEL: return "CANCEL";
-        case InputResult::ADVANCE: return "ADVANCE";
-    }
-
-    return "SOMETHING BROKE";
-}
-
-std::string convertCustomerType(CustomerType type)
-{
-    switch (type)
-    {
-        case CustomerType::GOBURIMON: return "GOBURIMON";
-        case CustomerType::GOTSUMON: return "GOTSUMON";
-        case CustomerType::MUCHOMON: return "MUCHOMON";
-        case CustomerType::WEEDMON: return "WEEDMON";
-        case CustomerType::INVALID: return "INVALID";
-    }
-
-    return "SOMETHING BROKE";
-}
-
-std::string convertItem(Item type)
-{
-    switch (type)
-    {
-        case Item::MEAT: return "MEAT";
-        case Item::MEDICINE: return "MEDICINE";
-        case Item::PORT_POTTY: return "PORT_POTTY";
-        case Item::INVALID: return "INVALID";
-    }
-
-    return "SOMETHING BROKE";
-}
-
-Mode convertMode(std::string input)
-{
-    if (input == "combined") return Mode::COMBINED;
-    if (input == "deep") return Mode::DEEP;
-    if (input == "heuristic") return Mode::HEURISTIC;
-
-    return Mode::COMBINED;
-}
-
-/*
- * Solve logic
- */
-
-void deepSolve(FullSolveEntry root, BestResult& best_result, int32_t max_depth)
-{
-    if (stop) return;
-
-    std::vector<FullSolveEntry> active_entries = { root };
-    std::vector<FullSolveEntry> next_iteration;
-
-    int32_t currentDepth = root.getInputs().size();
-    int32_t iterations   = std::min(SOLVE_DEPTH, max_depth - currentDepth);
-
-    if (iterations == 0) return;
-
-    for (int32_t i = 0; i < iterations; i++)
-    {
-        for (auto& entry : active_entries)
-        {
-            auto next_inputs = entry.next(best_result);
-            next_iteration.insert(next_iteration.end(), next_inputs.begin(), next_inputs.end());
-        }
-        std::swap(active_entries, next_iteration);
-        next_iteration.clear();
-    }
-
-    std::sort(active_entries.begin(), active_entries.end());
-
-    for (auto& entry : active_entries)
-        deepSolve(entry, best_result, max_depth);
-}
-
-void heuristicSolve(uint32_t seed, uint32_t attempts, uint32_t advances, BestResult& best_result)
-{
-    if (stop) return;
-
-    for (uint32_t j = 0; j < attempts; j++)
-        HeuristicSolveEntry(seed, advances).next(best_result);
-}
-
-BestResult solve(uint32_t seed,
-                 uint32_t maxAdvances        = 0,
-                 uint32_t heuristic_attempts = 0,
-                 uint32_t minimumScore       = IMPOSSIBLE_SCORE,
-                 Mode mode                   = Mode::COMBINED,
-                 int32_t depth               = DEFAULT_DEPTH)
-{
-    BestResult result(minimumScore);
-
-    std::vector<std::thread> threads;
-
-    if (mode == Mode::COMBINED || mode == Mode::HEURISTIC)
-    {
-        for (uint32_t i = 0; i <= maxAdvances; i++)
-            threads.emplace_back(heuristicSolve, seed, heuristic_attempts, i, std::ref(result));
-    }
-
-    if (mode == Mode::COMBINED || mode == Mode::DEEP)
-    {
-        for (uint32_t i = 0; i <= maxAdvances; i++)
-            threads.emplace_back(deepSolve, FullSolveEntry(seed, i), std::ref(result), depth);
-    }
-
-    std::for_each(threads.begin(), threads.end(), [](auto& a) { a.join(); });
-
-    if (result.getBest().has_value())
-    {
-        for (auto val : result.getBest()->getInputs()) // bestResult.sequence)
-        {
-            std::cout << std::format("{:12} -> {:12} | {:12} {}\n",
-                                     convertInput(val.input),
-                                     convertResult(val.result),
-                                     convertCustomerType(val.customer),
-                                     convertItem(val.item));
-        }
-        std::cout << "Customers: " << result.getBest()->getCustomerCount() << std::endl;
-        std::cout << "   Inputs: " << result.getBest()->getInputs().size() << std::endl;
-        std::cout << "   Profit: " << result.getBest()->getShop().getProfits() << std::endl;
-        std::cout << "    Score: " << result.getScore() << std::endl;
-        std::cout << "     Seed: " << result.getBest()->getShop().getInitialSeed() << std::endl;
-        std::cout << "  Version: " << VERSION << std::endl;
-    }
-
-    return result;
-}
+#include <stdexcept>
+#include <string>
 
 void abortHandler(int signal)
 {
     stop = true;
-    std::cout << "Aborted\n";
+    std::cerr << "Aborted\n";
 }
 
 int main(int count, char* args[])
@@ -197,6 +36,7 @@ int main(int count, char* args[])
     constexpr uint32_t DEFAULT_ADVANCES = 4;
     constexpr uint32_t DEFAULT_ATTEMPTS = 5000000;
     constexpr auto DEFAULT_MODE         = "combined";
+    constexpr auto DEFAULT_OUTPUT       = "text";
 
     namespace po = boost::program_options;
     po::variables_map vm;
@@ -210,16 +50,19 @@ int main(int count, char* args[])
     options("seed", po::value<uint32_t>(), "The initial seed for the shop, taken when talking to Monochromon.");
     options("mode,m",
             po::value<std::string>()->default_value(DEFAULT_MODE),
-            "The solver mode used. Valid: combined|deep|heuristic\n"
+            "The solver mode used. Valid: combined|deep|heuristic|macro\n"
             "combined -> use heuristic and deep solver in parallel, finds lowest score\n"
             "            heuristic is to find a quick base value, to speed up the deep solve\n"
+            "            together with a beam search, until both stop improving\n"
             "            might take several minutes, depending on the seed!\n"
             "deep -> use deep solver exclusively, finds lowest score\n"
             "        not recommended over combined, unless you use the --score option\n"
             "        might take several minutes, depending on the seed!\n"
             "heuristic -> use heuristic solver, doesn't find lowest score\n"
             "             not recommended, unless you want a result quickly\n"
-            "             fast, unless you turn heuristic_attempts very high");
+            "             fast, unless you turn heuristic_attempts very high\n"
+            "macro -> like combined, but the deep solver branches on whole customers instead of inputs\n"
+            "         ignores --depth, limited by --macro-fails and --macro-cancels per customer instead");
     options("score,s",
             po::value<uint32_t>()->default_value(IMPOSSIBLE_SCORE),
             "Initial \"best\" score, ignores any result worse than that.\n"
@@ -234,13 +77,87 @@ int main(int count, char* args[])
             "Recommended to use, it can reduce execution time significantly.");
     options("attempts",
             po::value<uint32_t>()->default_value(DEFAULT_ATTEMPTS),
-            "Number of attempts when using heuristic or combined solver.\n"
+            "Number of attempts per advance when using heuristic or combined solver.\n"
             "Rarely finds anything better after 10000000.");
     options("depth,d",
             po::value<uint32_t>()->default_value(DEFAULT_DEPTH),
             "Maximum number of inputs when using deep or combined solver.\n"
             "Higher values might find solutions with plenty CANCELs, that should be faster.\n"
             "On the flip side, it might increase run time significantly.");
+    options("macro-fails",
+            po::value<uint32_t>()->default_value(DEFAULT_MACRO_FAILS),
+            "Maximum number of DENYs per customer when using the macro solver.");
+    options("macro-cancels",
+            po::value<uint32_t>()->default_value(DEFAULT_MACRO_CANCELS),
+            "Maximum number of CANCELs per customer when using the macro solver.");
+    options("costs,c",
+            po::value<std::string>(),
+            "Cost profile file to score inputs with, instead of the built-in timings.\n"
+            "Each line has the form \"<name> = <frames>\", names not given keep their default.\n"
+            "Valid names: raise, normal, lower, cancel, static, deny, meat, non_mucho_medicine,\n"
+            "advance, goburimon_walk, gotsumon_walk, muchomon_walk, weedmon_walk");
+    options("output,o",
+            po::value<std::string>()->default_value(DEFAULT_OUTPUT),
+            "The output format. Valid: text|json|ndjson|binary\n"
+            "text -> human readable progress and result table\n"
+            "json -> a single JSON document with the results, written at the end\n"
+            "ndjson -> one JSON event per line: start, best, bound, stats and finished\n"
+            "binary -> compact little endian records of the same events, for bulk processing");
+    options("top,k",
+            po::value<uint32_t>()->default_value(1),
+            "Number of best routes to keep and print, sorted by score.\n"
+            "Pruning uses the worst of them as bound, so higher values increase run time.");
+    options("time-limit,t",
+            po::value<uint32_t>()->default_value(0),
+            "Stop after the given number of milliseconds and print the best result found so far.\n"
+            "0 means no limit.");
+    options("serve",
+            po::value<std::string>(),
+            "Run as a server on the given Unix domain socket instead of solving a single seed.\n"
+            "Takes one request per line and answers with ndjson events, see the README.\n"
+            "The other options are the defaults for all requests. Not supported on Windows.");
+    options("live",
+            "Read RNG states from stdin, one per line, and answer each with its best routes.\n"
+            "Each answer may take the --time-limit, 1000 ms if none is given.\n"
+            "While waiting the states following the last one get solved ahead of time,\n"
+            "those are answered instantly.");
+    options("coordinate",
+            po::value<std::string>(),
+            "Split the solve into shards in the given directory, wait for --work processes\n"
+            "to solve them and print the merged results. Splits the deep solve of the seed\n"
+            "into subtrees, or with --seeds the seed range into runs of seeds.\n"
+            "The directory has to be empty.");
+    options("seeds",
+            po::value<std::string>(),
+            "Seed range <first>:<last> for --coordinate, both inclusive.");
+    options("shard-size",
+            po::value<uint32_t>()->default_value(DEFAULT_SHARD_SIZE),
+            "Number of seeds or subtrees per shard handed to a worker.");
+    options("work",
+            po::value<std::string>(),
+            "Solve shards of the job in the given directory until the coordinator is done.\n"
+            "Any number of workers can share a directory, also across machines.\n"
+            "The settings come from the job, the other options are ignored.");
+    options("trace",
+            po::value<std::string>(),
+            "Write a timeline of the solver threads to the given file on exit, in the Chrome trace\n"
+            "format. Open it with ui.perfetto.dev or chrome://tracing.");
+    options("verify",
+            po::value<std::string>(),
+            "Replay the route in the given file from the seed instead of solving and check it.\n"
+            "Takes the text output of a previous run or plain input names.\n"
+            "Leading CATCH_UPs are advances, the score uses the --costs profile.");
+    options("fuzz",
+            po::value<uint32_t>()->implicit_value(DEFAULT_FUZZ_ITERATIONS),
+            "Compare the optimized solver engines against a plain replay on the given number of\n"
+            "random seeds and input streams, using the seed to generate them.");
+    options("estimate",
+            "Estimate the size of the deep search tree of the seed with random probes, print the\n"
+            "expected node count and runtime per advance and exit.");
+    options("auto",
+            "Estimate the search tree first and pick the mode, the advances that fit the --time-limit\n"
+            "and the levels expanded at once by the deep solver from it. Prints the estimate and the\n"
+            "picked settings to stderr.");
 
     pos.add("seed", 1);
 
@@ -252,6 +169,71 @@ int main(int count, char* args[])
         std::cout << desc;
         return 1;
     }
+    std::optional<TraceFile> trace;
+    if (vm.count("trace")) trace.emplace(vm["trace"].as<std::string>());
+
+    CostProfile costs = DEFAULT_COSTS;
+    if (vm.count("costs"))
+    {
+        auto profile = loadCostProfile(vm["costs"].as<std::string>());
+        if (!profile) return 1;
+        costs = *profile;
+    }
+
+    MacroLimits macroLimits = {
+        .fails   = vm["macro-fails"].as<uint32_t>(),
+        .cancels = vm["macro-cancels"].as<uint32_t>(),
+    };
+
+    SolveSettings settings = {
+        .seed        = vm.count("seed") ? vm["seed"].as<uint32_t>() : 0,
+        .advances    = vm["advances"].as<uint32_t>(),
+        .attempts    = vm["attempts"].as<uint32_t>(),
+        .score       = vm["score"].as<uint32_t>(),
+        .mode        = convertMode(vm["mode"].as<std::string>()),
+        .depth       = static_cast<int32_t>(vm["depth"].as<uint32_t>()),
+        .top         = vm["top"].as<uint32_t>(),
+        .costs       = costs,
+        .macroLimits = macroLimits,
+        .timeLimit   = std::chrono::milliseconds(vm["time-limit"].as<uint32_t>()),
+    };
+
+    // the server takes its seeds from the requests, everything else is a default for them
+    if (vm.count("serve")) return serve(vm["serve"].as<std::string>(), settings);
+    if (vm.count("work")) return work(vm["work"].as<std::string>());
+    if (vm.count("live"))
+        return live(std::cin, std::cout, convertOutputFormat(vm["output"].as<std::string>()), settings);
+
+    std::optional<SeedRange> seeds;
+    if (vm.count("seeds"))
+    {
+        auto range     = vm["seeds"].as<std::string>();
+        auto separator = range.find(':');
+        try
+        {
+            if (separator == std::string::npos) throw std::invalid_argument(range);
+            seeds = SeedRange{
+                .first = static_cast<uint32_t>(std::stoul(range.substr(0, separator))),
+                .last  = static_cast<uint32_t>(std::stoul(range.substr(separator + 1))),
+            };
+        }
+        catch (const std::exception&)
+        {
+            std::cout << "Invalid seed range " << range << ", expected <first>:<last>\n";
+            return 1;
+        }
+    }
+
+    if (vm.count("coordinate") && seeds)
+    {
+        auto output = createOutput(convertOutputFormat(vm["output"].as<std::string>()), std::cout);
+        return coordinate(vm["coordinate"].as<std::string>(),
+                          settings,
+                          seeds,
+                          vm["shard-size"].as<uint32_t>(),
+                          *output);
+    }
+
     if (!vm.count("seed"))
     {
         std::cout << "You must specify a seed!\n";
@@ -259,18 +241,41 @@ int main(int count, char* args[])
         return 1;
     }
 
-    uint32_t advances           = vm["advances"].as<uint32_t>();
-    uint32_t heuristic_attempts = vm["attempts"].as<uint32_t>();
-    uint32_t seed               = vm["seed"].as<uint32_t>();
-    uint32_t score              = vm["score"].as<uint32_t>();
-    uint32_t depth              = vm["depth"].as<uint32_t>();
-    Mode mode                   = convertMode(vm["mode"].as<std::string>());
+    if (vm.count("verify"))
+    {
+        auto route = loadRoute(vm["verify"].as<std::string>());
+        if (!route) return 1;
+
+        auto result = replay(settings.seed, *route, costs);
+        printReplay(result, std::cout);
+        return result.isValid() ? 0 : 1;
+    }
+    if (vm.count("fuzz")) return fuzz(settings.seed, vm["fuzz"].as<uint32_t>(), std::cout) == 0 ? 0 : 1;
 
+    if (vm.count("estimate"))
+    {
+        printEstimate(estimateTree(settings), std::cout);
+        return 0;
+    }
+    if (vm.count("auto"))
+    {
+        auto estimate = estimateTree(settings);
+        settings      = autoTune(settings, estimate);
+        printEstimate(estimate, std::cerr);
+        printTuning(settings, std::cerr);
+    }
+
+    auto output = createOutput(convertOutputFormat(vm["output"].as<std::string>()), std::cout);
+    if (vm.count("coordinate"))
+        return coordinate(vm["coordinate"].as<std::string>(), settings, {}, vm["shard-size"].as<uint32_t>(), *output);
+
+    output->start(toParameters(settings));
+
+    SolveCache cache;
     auto start      = std::chrono::high_resolution_clock::now();
-    BestResult best = solve(seed, advances, heuristic_attempts, score, mode, depth);
+    BestResult best = solve(settings, cache, output.get());
 
-    std::cout << "finished" << std::endl;
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() -
-                                                                       start)
-              << std::endl;
-}
\ No newline at end of file
+    output->finished(best.getResults(),
+                     std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() -
+                                                                           start));
+}
@@ -0,0 +1,500 @@
+#include "Output.hpp"
+
+#include "FullSolver.hpp"
+#include "MonochromeShop.hpp"
+
+#include <format>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+    using namespace std::chrono;
+
+    /*
+     * Text output, meant for humans
+     */
+
+    class TextOutput : public SolveOutput
+    {
+    private:
+        std::ostream& out;
+
+    public:
+        explicit TextOutput(std::ostream& out)
+            : out(out)
+        {
+        }
+
+        void start(const SolveParameters&) override {}
+
+        void newBest(const ISolveEntry& best, uint32_t) override
+        {
+            out << "New best: " << best.getScore() << "\n";
+        }
+
+        void newBound(uint32_t bound, uint32_t capacity) override
+        {
+            out << "New top " << capacity << " bound: " << bound << "\n";
+        }
+
+        void stats(const SolveStats&) override {}
+
+        void finished(const std::vector<ISolveEntry>& results, milliseconds elapsed) override
+        {
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                auto& entry = results[i];
+                if (results.size() > 1) out << "Route #" << (i + 1) << ":\n";
+
+                for (auto val : entry.getInputs())
+                    out << formatSequenceResult(val) << "\n";
+                out << "Customers: " << entry.getCustomerCount() << std::endl;
+                out << "   Inputs: " << entry.getInputs().size() << std::endl;
+                out << "   Profit: " << entry.getShop().getProfits() << std::endl;
+                out << "    Score: " << entry.getScore() << std::endl;
+                out << "     Seed: " << entry.getShop().getInitialSeed() << std::endl;
+                out << "  Version: " << VERSION << std::endl;
+            }
+
+            out << "finished" << std::endl;
+            out << elapsed << std::endl;
+        }
+    };
+
+    /*
+     * JSON output, either as one document at the end or as one event per line while running
+     */
+
+    // quoted and escaped, every string goes through here so that none can break the JSON
+    std::string toJson(const std::string& text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                quoted += std::format("\\{}", c);
+            else if (static_cast<unsigned char>(c) < 0x20)
+                quoted += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+            else
+                quoted += c;
+        }
+
+        return quoted + "\"";
+    }
+
+    std::string toJson(const ISolveEntry& entry)
+    {
+        std::string inputs;
+        for (auto val : entry.getInputs())
+        {
+            if (!inputs.empty()) inputs += ",";
+            inputs += std::format(R"({{"input":"{}","result":"{}","customer":"{}","item":"{}"}})",
+                                  convertInput(val.input),
+                                  convertResult(val.result),
+                                  convertCustomerType(val.customer),
+                                  convertItem(val.item));
+        }
+
+        return std::format(R"({{"seed":{},"score":{},"profit":{},"customers":{},"inputs":[{}]}})",
+                           entry.getShop().getInitialSeed(),
+                           entry.getScore(),
+                           entry.getShop().getProfits(),
+                           entry.getCustomerCount(),
+                           inputs);
+    }
+
+    std::string toJson(const std::vector<ISolveEntry>& results)
+    {
+        std::string routes;
+        for (auto& entry : results)
+        {
+            if (!routes.empty()) routes += ",";
+            routes += toJson(entry);
+        }
+
+        return "[" + routes + "]";
+    }
+
+    std::string toJson(const SolveParameters& params)
+    {
+        return std::format(
+            R"("seed":{},"advances":{},"attempts":{},"score":{},"depth":{},"top":{},"mode":{},"version":{})",
+            params.seed,
+            params.advances,
+            params.attempts,
+            params.score,
+            params.depth,
+            params.top,
+            toJson(params.mode),
+            VERSION);
+    }
+
+    class JsonOutput : public SolveOutput
+    {
+    private:
+        std::ostream& out;
+        bool streaming;
+        std::string parameters;
+        std::string open; // start of every object, including the id if there is one
+
+    public:
+        JsonOutput(std::ostream& out, bool streaming, const std::string& id)
+            : out(out)
+            , streaming(streaming)
+            , open(id.empty() ? "{" : std::format(R"({{"id":{},)", toJson(id)))
+        {
+        }
+
+        void start(const SolveParameters& params) override
+        {
+            parameters = toJson(params);
+            if (streaming) out << open << R"("event":"start",)" << parameters << "}" << std::endl;
+        }
+
+        void newBest(const ISolveEntry& best, uint32_t bound) override
+        {
+            if (!streaming) return;
+            out << std::format(R"({}"event":"best","score":{},"bound":{},"route":{}}})",
+                               open,
+                               best.getScore(),
+                               bound,
+                               toJson(best))
+                << std::endl;
+        }
+
+        void newBound(uint32_t bound, uint32_t capacity) override
+        {
+            if (!streaming) return;
+            out << std::format(R"({}"event":"bound","bound":{},"top":{}}})", open, bound, capacity) << std::endl;
+        }
+
+        void stats(const SolveStats& stats) override
+        {
+            if (!streaming) return;
+            out << std::format(R"({}"event":"stats","elapsed_ms":{},"best":{},"bound":{},"nodes":{}}})",
+                               open,
+                               stats.elapsed.count(),
+                               stats.best,
+                               stats.bound,
+                               stats.nodes)
+                << std::endl;
+        }
+
+        void finished(const std::vector<ISolveEntry>& results, milliseconds elapsed) override
+        {
+            if (streaming)
+                out << std::format(R"({}"event":"finished","elapsed_ms":{},"results":{}}})",
+                                   open,
+                                   elapsed.count(),
+                                   toJson(results))
+                    << std::endl;
+            else
+                out << std::format(R"({}{},"elapsed_ms":{},"results":{}}})",
+                                   open,
+                                   parameters,
+                                   elapsed.count(),
+                                   toJson(results))
+                    << std::endl;
+        }
+    };
+
+    /*
+     * Binary output, a stream of little endian records for bulk processing.
+     *
+     * Every run starts with the magic "MCSB" and a format version byte, followed by records that start with
+     * their RecordType byte. A route is written as seed, score, profit, customers and input count (all u32),
+     * followed by 4 bytes per input: Input, InputResult, CustomerType and Item, using their enum values.
+     */
+
+    constexpr uint8_t BINARY_FORMAT_VERSION = 1;
+
+    enum class RecordType : uint8_t
+    {
+        START    = 1, // seed, advances, attempts, score, depth, top (u32), mode (string)
+        BEST     = 2, // bound (u32), route
+        BOUND    = 3, // bound, top (u32)
+        STATS    = 4, // elapsed_ms (u64), best, bound (u32), nodes (u64)
+        FINISHED = 5, // elapsed_ms (u64), route count (u32), routes
+    };
+
+    class BinaryOutput : public SolveOutput
+    {
+    private:
+        std::ostream& out;
+
+        void write8(uint8_t value) { out.put(static_cast<char>(value)); }
+
+        void write32(uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                write8(static_cast<uint8_t>(value >> (i * 8)));
+        }
+
+        void write64(uint64_t value)
+        {
+            for (int i = 0; i < 8; i++)
+                write8(static_cast<uint8_t>(value >> (i * 8)));
+        }
+
+        void writeString(const std::string& value)
+        {
+            write32(static_cast<uint32_t>(value.size()));
+            out.write(value.data(), value.size());
+        }
+
+        void writeRoute(const ISolveEntry& entry)
+        {
+            auto inputs = entry.getInputs();
+
+            write32(entry.getShop().getInitialSeed());
+            write32(entry.getScore());
+            write32(entry.getShop().getProfits());
+            write32(entry.getCustomerCount());
+            write32(static_cast<uint32_t>(inputs.size()));
+            for (auto val : inputs)
+            {
+                write8(static_cast<uint8_t>(val.input));
+                write8(static_cast<uint8_t>(val.result));
+                write8(static_cast<uint8_t>(val.customer));
+                write8(static_cast<uint8_t>(val.item));
+            }
+        }
+
+    public:
+        explicit BinaryOutput(std::ostream& out)
+            : out(out)
+        {
+#ifdef _WIN32
+            if (&out == &std::cout) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        }
+
+        void start(const SolveParameters& params) override
+        {
+            out.write("MCSB", 4);
+            write8(BINARY_FORMAT_VERSION);
+            write8(static_cast<uint8_t>(RecordType::START));
+            write32(params.seed);
+            write32(params.advances);
+            write32(params.attempts);
+            write32(params.score);
+            write32(params.depth);
+            write32(params.top);
+            writeString(params.mode);
+            out.flush();
+        }
+
+        void newBest(const ISolveEntry& best, uint32_t bound) override
+        {
+            write8(static_cast<uint8_t>(RecordType::BEST));
+            write32(bound);
+            writeRoute(best);
+            out.flush();
+        }
+
+        void newBound(uint32_t bound, uint32_t capacity) override
+        {
+            write8(static_cast<uint8_t>(RecordType::BOUND));
+            write32(bound);
+            write32(capacity);
+            out.flush();
+        }
+
+        void stats(const SolveStats& stats) override
+        {
+            write8(static_cast<uint8_t>(RecordType::STATS));
+            write64(stats.elapsed.count());
+            write32(stats.best);
+            write32(stats.bound);
+            write64(stats.nodes);
+            out.flush();
+        }
+
+        void finished(const std::vector<ISolveEntry>& results, milliseconds elapsed) override
+        {
+            write8(static_cast<uint8_t>(RecordType::FINISHED));
+            write64(elapsed.count());
+            write32(static_cast<uint32_t>(results.size()));
+            for (auto& entry : results)
+                writeRoute(entry);
+            out.flush();
+        }
+    };
+} // namespace
+
+std::unique_ptr<SolveOutput> createOutput(OutputFormat format, std::ostream& stream, const std::string& id)
+{
+    switch (format)
+    {
+        case OutputFormat::TEXT: return std::make_unique<TextOutput>(stream);
+        case OutputFormat::JSON: return std::make_unique<JsonOutput>(stream, false, id);
+        case OutputFormat::NDJSON: return std::make_unique<JsonOutput>(stream, true, id);
+        case OutputFormat::BINARY: return std::make_unique<BinaryOutput>(stream);
+    }
+
+    return std::make_unique<TextOutput>(stream);
+}
+
+/*
+ * BestResultReporter implementation
+ */
+
+BestResultReporter::BestResultReporter(const BestResult& result, SolveOutput& output)
+    : result(result)
+    , output(output)
+    , startTime(steady_clock::now())
+    , lastStats(startTime)
+    , reportedGeneration(result.getGeneration())
+    , reportedBest(result.getBestScore())
+    , reportedBound(result.getScore())
+    , thread(
+          [this]
+          {
+              while (running)
+              {
+                  std::this_thread::sleep_for(REPORT_INTERVAL);
+                  report();
+              }
+          })
+{
+}
+
+BestResultReporter::~BestResultReporter()
+{
+    running = false;
+    thread.join();
+    report();
+}
+
+void BestResultReporter::report()
+{
+    auto now = steady_clock::now();
+    if (now - lastStats >= STATS_INTERVAL)
+    {
+        lastStats = now;
+        output.stats({
+            .elapsed = duration_cast<milliseconds>(now - startTime),
+            .best    = result.getBestScore(),
+            .bound   = result.getScore(),
+            .nodes   = result.getVisitedNodes(),
+        });
+    }
+
+    uint32_t generation = result.getGeneration();
+    if (generation == reportedGeneration) return;
+
+    reportedGeneration = generation;
+
+    uint32_t best  = result.getBestScore();
+    uint32_t bound = result.getScore();
+    if (best != reportedBest)
+    {
+        if (auto entry = result.getBest()) output.newBest(*entry, bound);
+    }
+    else if (result.getCapacity() > 1 && bound != reportedBound)
+        output.newBound(bound, result.getCapacity());
+
+    reportedBest  = best;
+    reportedBound = bound;
+}
+
+std::string formatSequenceResult(const SolveSequenceResult& result)
+{
+    return std::format("{:12} -> {:12} | {:12} {}",
+                       convertInput(result.input),
+                       convertResult(result.result),
+                       convertCustomerType(result.customer),
+                       convertItem(result.item));
+}
+
+/*
+ * Enum -> String conversion helper
+ */
+
+std::string convertInput(Input input)
+{
+    switch (input)
+    {
+        case Input::LOWER: return "LOWER";
+        case Input::LOWER_CANCEL: return "LOWER_CANCEL";
+        case Input::RAISE_CANCEL: return "RAISE_CANCEL";
+        case Input::RAISE: return "RAISE";
+        case Input::NORMAL_CANCEL: return "NORMAL_CANCEL";
+        case Input::NORMAL: return "NORMAL";
+        case Input::CATCH_UP: return "CATCH_UP";
+    }
+
+    return "SOMETHING BROKE";
+}
+
+std::string convertResult(InputResult result)
+{
+    switch (result)
+    {
+        case InputResult::BUY: return "BUY";
+        case InputResult::BUY_ENDED: return "BUY_ENDED";
+        case InputResult::LEAVE_ENDED: return "LEAVE_ENDED";
+        case InputResult::LEAVE: return "LEAVE";
+        case InputResult::DENY: return "DENY";
+        case InputResult::CANCEL: return "CANCEL";
+        case InputResult::ADVANCE: return "ADVANCE";
+    }
+
+    return "SOMETHING BROKE";
+}
+
+std::string convertCustomerType(CustomerType type)
+{
+    switch (type)
+    {
+        case CustomerType::GOBURIMON: return "GOBURIMON";
+        case CustomerType::GOTSUMON: return "GOTSUMON";
+        case CustomerType::MUCHOMON: return "MUCHOMON";
+        case CustomerType::WEEDMON: return "WEEDMON";
+        case CustomerType::INVALID: return "INVALID";
+    }
+
+    return "SOMETHING BROKE";
+}
+
+std::string convertItem(Item type)
+{
+    switch (type)
+    {
+        case Item::MEAT: return "MEAT";
+        case Item::MEDICINE: return "MEDICINE";
+        case Item::PORT_POTTY: return "PORT_POTTY";
+        case Item::INVALID: return "INVALID";
+    }
+
+    return "SOMETHING BROKE";
+}
+
+OutputFormat convertOutputFormat(std::string input)
+{
+    if (input == "text") return OutputFormat::TEXT;
+    if (input == "json") return OutputFormat::JSON;
+    if (input == "ndjson") return OutputFormat::NDJSON;
+    if (input == "binary") return OutputFormat::BINARY;
+
+    return OutputFormat::TEXT;
+}
+
+std::optional<Input> parseInput(const std::string& name)
+{
+    for (auto input : { Input::RAISE,
+                        Input::RAISE_CANCEL,
+                        Input::NORMAL,
+                        Input::NORMAL_CANCEL,
+                        Input::LOWER,
+                        Input::LOWER_CANCEL,
+                        Input::CATCH_UP })
+        if (convertInput(input) == name) return input;
+
+    return std::nullopt;
+}
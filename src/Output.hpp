@@ -0,0 +1,98 @@
+#pragma once
+#include "FullSolver.hpp"
+#include "MonochromeShop.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr auto REPORT_INTERVAL = std::chrono::milliseconds(50);
+constexpr auto STATS_INTERVAL  = std::chrono::seconds(1);
+
+enum class OutputFormat
+{
+    TEXT,
+    JSON,
+    NDJSON,
+    BINARY,
+};
+
+struct SolveParameters
+{
+    uint32_t seed;
+    uint32_t advances;
+    uint32_t attempts;
+    uint32_t score;
+    uint32_t depth;
+    uint32_t top;
+    std::string mode;
+};
+
+struct SolveStats
+{
+    std::chrono::milliseconds elapsed;
+    uint32_t best;
+    uint32_t bound;
+    uint64_t nodes;
+};
+
+/*
+ * Receives the events of a solver run and writes them in one of the supported formats.
+ */
+class SolveOutput
+{
+public:
+    virtual ~SolveOutput() = default;
+
+    virtual void start(const SolveParameters& params)                                              = 0;
+    virtual void newBest(const ISolveEntry& best, uint32_t bound)                                  = 0;
+    virtual void newBound(uint32_t bound, uint32_t capacity)                                       = 0;
+    virtual void stats(const SolveStats& stats)                                                    = 0;
+    virtual void finished(const std::vector<ISolveEntry>& results, std::chrono::milliseconds elapsed) = 0;
+};
+
+// JSON objects get an "id" field when one is given, to tell several solves on one stream apart
+std::unique_ptr<SolveOutput> createOutput(OutputFormat format, std::ostream& stream, const std::string& id = "");
+
+/*
+ * Forwards new bests and periodic stats of a BestResult to a SolveOutput from its own thread,
+ * so solver threads never block on output.
+ */
+class BestResultReporter
+{
+private:
+    const BestResult& result;
+    SolveOutput& output;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point lastStats;
+    std::atomic_bool running = true;
+    uint32_t reportedGeneration;
+    uint32_t reportedBest;
+    uint32_t reportedBound;
+    std::thread thread;
+
+    void report();
+
+public:
+    BestResultReporter(const BestResult& result, SolveOutput& output);
+    ~BestResultReporter();
+};
+
+// one row of the text output, input and result followed by the customer
+std::string formatSequenceResult(const SolveSequenceResult& result);
+
+/*
+ * Enum -> String conversion helper
+ */
+
+std::string convertInput(Input input);
+std::string convertResult(InputResult result);
+std::string convertCustomerType(CustomerType type);
+std::string convertItem(Item type);
+OutputFormat convertOutputFormat(std::string input);
+std::optional<Input> parseInput(const std::string& name);
@@ -0,0 +1,225 @@
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+    /*
+     * Blocking tasks, like the solvers that run until their solve is done, always get a thread. Everything else only
+     * gets one while the pool has fewer threads than blocking tasks plus cores, so nested parallel levels can't grow it
+     * without bound.
+     */
+    class ThreadPool
+    {
+    private:
+        struct Task
+        {
+            std::function<void()> function;
+            bool blocking;
+        };
+
+        std::mutex mutex;
+        std::condition_variable available;
+        std::deque<Task> tasks;
+        std::vector<std::thread> threads;
+        size_t idle     = 0;
+        size_t blocking = 0; // queued or running
+        bool quit       = false;
+
+        void work()
+        {
+            std::unique_lock lock(mutex);
+            while (true)
+            {
+                idle++;
+                available.wait(lock, [this] { return quit || !tasks.empty(); });
+                idle--;
+                if (tasks.empty()) return;
+
+                auto task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task.function();
+                lock.lock();
+
+                if (task.blocking) blocking--;
+            }
+        }
+
+    public:
+        ~ThreadPool()
+        {
+            {
+                std::scoped_lock lock(mutex);
+                quit = true;
+            }
+            available.notify_all();
+            std::ranges::for_each(threads, [](auto& thread) { thread.join(); });
+        }
+
+        bool submit(std::function<void()> function, bool isBlocking)
+        {
+            std::scoped_lock lock(mutex);
+
+            // woken threads count as idle until they took their task, so every queued task has one of its own
+            bool needsThread = tasks.size() >= idle;
+            if (needsThread && !isBlocking)
+            {
+                size_t cores = std::max(std::thread::hardware_concurrency(), 1U);
+                if (threads.size() >= blocking + cores) return false;
+            }
+
+            tasks.push_back({ std::move(function), isBlocking });
+            if (isBlocking) blocking++;
+
+            if (needsThread)
+                threads.emplace_back(&ThreadPool::work, this);
+            else
+                available.notify_one();
+
+            return true;
+        }
+    };
+
+    ThreadPool& getPool()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+} // namespace
+
+/*
+ * TaskGroup implementation
+ */
+
+bool TaskGroup::submit(std::function<void()> task, bool blocking)
+{
+    {
+        std::scoped_lock lock(mutex);
+        pending++;
+    }
+
+    bool submitted = getPool().submit(
+        [this, task = std::move(task)]
+        {
+            task();
+
+            // notified under the lock, the group may be gone as soon as a waiter sees pending at 0
+            std::scoped_lock lock(mutex);
+            if (--pending == 0) finished.notify_all();
+        },
+        blocking);
+
+    if (!submitted)
+    {
+        std::scoped_lock lock(mutex);
+        pending--;
+    }
+
+    return submitted;
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+    submit(std::move(task), true);
+}
+
+bool TaskGroup::tryRun(std::function<void()> task)
+{
+    return submit(std::move(task), false);
+}
+
+void TaskGroup::wait()
+{
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+}
+
+size_t getChunkCount(size_t count)
+{
+    if (count < PARALLEL_MIN_SIZE) return 1;
+
+    size_t threads = std::max(std::thread::hardware_concurrency(), 1U);
+    return std::clamp<size_t>(count / PARALLEL_MIN_CHUNK, 1, threads);
+}
+
+std::pair<size_t, size_t> getChunkRange(size_t count, size_t chunks, size_t chunk)
+{
+    return { count * chunk / chunks, count * (chunk + 1) / chunks };
+}
+
+void parallelFor(size_t chunks, const std::function<void(size_t)>& func)
+{
+    // the first chunk runs here, and so do chunks that find no thread in the pool
+    TaskGroup tasks;
+    std::vector<size_t> own;
+    for (size_t i = 0; i < chunks; i++)
+    {
+        if (i == 0 || !tasks.tryRun([&func, i] { func(i); })) own.push_back(i);
+    }
+
+    for (auto chunk : own)
+        func(chunk);
+    tasks.wait();
+}
+
+std::vector<uint32_t> parallelRadixSort(const std::vector<uint32_t>& keys)
+{
+    constexpr uint32_t RADIX_BITS = 8;
+    constexpr uint32_t BUCKETS    = 1 << RADIX_BITS;
+    using Histogram               = std::array<size_t, BUCKETS>;
+
+    const size_t count  = keys.size();
+    const size_t chunks = getChunkCount(count);
+
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+
+    // not worth the histograms for small inputs
+    if (chunks == 1 && count < BUCKETS * 4)
+    {
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        return order;
+    }
+
+    std::vector<uint32_t> buffer(count);
+
+    uint32_t maxKey = count > 0 ? *std::max_element(keys.begin(), keys.end()) : 0;
+
+    for (uint32_t shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += RADIX_BITS)
+    {
+        std::vector<Histogram> histograms(chunks, Histogram{});
+
+        parallelFor(chunks,
+                    [&](size_t chunk)
+                    {
+                        auto [first, last] = getChunkRange(count, chunks, chunk);
+                        for (size_t i = first; i < last; i++)
+                            histograms[chunk][(keys[order[i]] >> shift) & (BUCKETS - 1)]++;
+                    });
+
+        // exclusive prefix sum over (digit, chunk), so every chunk scatters into its own stable slots
+        size_t offset = 0;
+        for (uint32_t digit = 0; digit < BUCKETS; digit++)
+        {
+            for (auto& histogram : histograms)
+                offset += std::exchange(histogram[digit], offset);
+        }
+
+        parallelFor(chunks,
+                    [&](size_t chunk)
+                    {
+                        auto [first, last] = getChunkRange(count, chunks, chunk);
+                        for (size_t i = first; i < last; i++)
+                            buffer[histograms[chunk][(keys[order[i]] >> shift) & (BUCKETS - 1)]++] = order[i];
+                    });
+
+        std::swap(order, buffer);
+    }
+
+    return order;
+}
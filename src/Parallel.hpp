@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+constexpr size_t PARALLEL_MIN_SIZE  = 16384; // below this everything runs on the calling thread
+constexpr size_t PARALLEL_MIN_CHUNK = 4096;
+
+/*
+ * Tasks run on threads of a process-wide pool, which keep running between tasks so that solves and frontier levels
+ * don't start threads of their own. Waits for its tasks when it goes out of scope.
+ */
+class TaskGroup
+{
+private:
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t pending = 0;
+
+    bool submit(std::function<void()> task, bool blocking);
+
+public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&)            = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup() { wait(); }
+
+    // for tasks that keep their thread for long, like a solver, they always get one right away
+    void run(std::function<void()> task);
+
+    // for short tasks, false when the pool already has as many threads as it allows, the caller runs it instead then
+    [[nodiscard]] bool tryRun(std::function<void()> task);
+
+    void wait();
+};
+
+/*
+ * Number of chunks to split count elements into, one per hardware thread at most.
+ */
+size_t getChunkCount(size_t count);
+
+/*
+ * Half-open element range [first, second) of the given chunk.
+ */
+std::pair<size_t, size_t> getChunkRange(size_t count, size_t chunks, size_t chunk);
+
+/*
+ * Calls func for every chunk in [0, chunks), the first one on the calling thread along with any the pool has no
+ * thread for.
+ */
+void parallelFor(size_t chunks, const std::function<void(size_t)>& func);
+
+/*
+ * Stable LSD radix sort, returns the indices of keys in ascending key order.
+ */
+std::vector<uint32_t> parallelRadixSort(const std::vector<uint32_t>& keys);
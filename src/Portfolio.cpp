@@ -0,0 +1,59 @@
+#include "Portfolio.hpp"
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+Portfolio::Portfolio(uint64_t heuristicAttempts)
+    : heuristicAttempts(heuristicAttempts)
+    , start(steady_clock::now())
+    , lastGain(start)
+{
+}
+
+Portfolio::Rate& Portfolio::getRate(Strategy strategy)
+{
+    return strategy == Strategy::HEURISTIC ? heuristic : beam;
+}
+
+Strategy Portfolio::pick()
+{
+    std::scoped_lock lock(mutex);
+
+    bool canSample = heuristicAttempts >= HEURISTIC_BATCH;
+
+    // both had their chance and nothing came of it for a while, it's the deep solver's turn
+    auto now      = steady_clock::now();
+    auto patience = std::max<steady_clock::duration>(PORTFOLIO_PLATEAU, (lastGain - start) * PORTFOLIO_PATIENCE);
+    bool tried    = (heuristic.slices > 0 || !canSample) && beam.slices > 0;
+    if (tried && now - lastGain > patience) plateaued = true;
+    if (plateaued) return Strategy::DEEP;
+
+    auto better = heuristic.get() >= beam.get() ? Strategy::HEURISTIC : Strategy::BEAM;
+    auto other  = better == Strategy::HEURISTIC ? Strategy::BEAM : Strategy::HEURISTIC;
+
+    // untried ones first, afterwards an occasional slice for the worse one keeps its rate up to date
+    Strategy strategy;
+    if (heuristic.slices == 0 || beam.slices == 0)
+        strategy = heuristic.slices == 0 ? Strategy::HEURISTIC : Strategy::BEAM;
+    else
+        strategy = ++picks % PORTFOLIO_EXPLORE == 0 ? other : better;
+
+    if (strategy == Strategy::HEURISTIC && !canSample) strategy = Strategy::BEAM;
+    if (strategy == Strategy::HEURISTIC) heuristicAttempts -= HEURISTIC_BATCH;
+
+    // counted right away, so that concurrent picks don't all go to the same untried strategy
+    getRate(strategy).slices++;
+    return strategy;
+}
+
+void Portfolio::report(Strategy strategy, nanoseconds elapsed, uint32_t gain)
+{
+    std::scoped_lock lock(mutex);
+
+    auto& rate   = getRate(strategy);
+    rate.gain    = rate.gain * PORTFOLIO_DECAY + gain;
+    rate.seconds = rate.seconds * PORTFOLIO_DECAY + duration<double>(elapsed).count();
+
+    if (gain > 0) lastGain = steady_clock::now();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+constexpr uint32_t HEURISTIC_BATCH    = 1 << 12; // heuristic attempts per slice
+constexpr uint32_t BEAM_WIDTH         = 64;      // width of the first beam, doubles with every further one
+constexpr uint32_t MAX_BEAM_WIDTH     = 1 << 16;
+constexpr uint32_t PORTFOLIO_EXPLORE  = 8;       // every n-th slice goes to the worse strategy to keep its rate current
+constexpr double PORTFOLIO_DECAY      = 0.8;     // weight of older slices in the gain rates
+constexpr uint32_t PORTFOLIO_PATIENCE = 4;       // retire after this many times as long without gain as before it
+constexpr auto PORTFOLIO_PLATEAU      = std::chrono::milliseconds(5000); // shortest time without gain to retire
+
+enum class Strategy
+{
+    HEURISTIC, // random sampling
+    BEAM,      // breadth-first keeping only the best nodes of every level
+    DEEP,      // none of the above pays off anymore, leave the core to the deep solver
+};
+
+/*
+ * Decides what the helper threads of a combined solve work on next. Each slice reports how much it lowered the bound,
+ * the strategy with the higher recent gain per second gets most of the slices. Once neither has lowered the bound for
+ * PORTFOLIO_PATIENCE times as long as it took to get to the last gain, but at least PORTFOLIO_PLATEAU, all helpers
+ * retire and leave every core to the exhaustive deep search. Random sampling finds improvements ever more rarely,
+ * waiting relative to the time so far keeps it from quitting right before the next one.
+ */
+class Portfolio
+{
+private:
+    struct Rate
+    {
+        double gain     = 0; // decayed frames of bound improvement
+        double seconds  = 0; // decayed time spent
+        uint32_t slices = 0;
+
+        double get() const { return seconds > 0 ? gain / seconds : 0; }
+    };
+
+    std::mutex mutex;
+    Rate heuristic;
+    Rate beam;
+    uint64_t heuristicAttempts; // left to hand out, --attempts per advance
+    uint32_t picks = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastGain;
+    bool plateaued = false;
+
+    Rate& getRate(Strategy strategy);
+
+public:
+    explicit Portfolio(uint64_t heuristicAttempts);
+
+    Strategy pick();
+    void report(Strategy strategy, std::chrono::nanoseconds elapsed, uint32_t gain);
+};
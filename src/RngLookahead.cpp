@@ -0,0 +1,91 @@
+#include "RngLookahead.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr uint32_t PROFIT_ROWS = LOOKAHEAD_WINDOW + 3; // spawns beyond the window are assumed to be the best
+} // namespace
+
+uint32_t RngLookahead::getSlot(uint32_t state)
+{
+    return (state * 0x9E3779B1U) >> 20; // 12 bit, matching INDEX_SIZE
+}
+
+RngLookahead::RngLookahead(uint32_t seed)
+    : indexStates(INDEX_SIZE)
+    , indexOffsets(INDEX_SIZE, NO_OFFSET)
+    , maxProfits((LOOKAHEAD_CUSTOMERS + 1) * PROFIT_ROWS)
+{
+    const uint32_t bestProfit = getProfit(Item::MEDICINE, Offer::PLUS_50);
+
+    std::vector<uint32_t> spawnProfits(LOOKAHEAD_WINDOW);
+    DW1Random rng(seed);
+    for (uint32_t offset = 0; offset < LOOKAHEAD_WINDOW; offset++)
+    {
+        uint32_t slot = getSlot(rng.getState());
+        while (indexOffsets[slot] != NO_OFFSET)
+            slot = (slot + 1) % INDEX_SIZE;
+
+        indexStates[slot]  = rng.getState();
+        indexOffsets[slot] = offset;
+
+        DW1Random spawn      = rng;
+        spawnProfits[offset] = getProfit(rollCustomer(spawn).item, Offer::PLUS_50);
+        rng.next();
+    }
+
+    auto at = [&](uint32_t customers, uint32_t offset) -> uint16_t&
+    { return maxProfits[customers * PROFIT_ROWS + offset]; };
+
+    for (uint32_t customers = 1; customers <= LOOKAHEAD_CUSTOMERS; customers++)
+    {
+        for (uint32_t offset = LOOKAHEAD_WINDOW; offset < PROFIT_ROWS; offset++)
+            at(customers, offset) = customers * bestProfit;
+
+        // either nobody spawns at this offset, or somebody does and the rest follows 3 draws later
+        for (uint32_t offset = LOOKAHEAD_WINDOW; offset-- > 0;)
+        {
+            uint32_t skip  = at(customers, offset + 1);
+            uint32_t spawn = spawnProfits[offset] + getMaxProfit(customers - 1, offset + 3);
+            at(customers, offset) = std::max(skip, spawn);
+        }
+    }
+}
+
+std::optional<uint32_t> RngLookahead::getOffset(uint32_t state) const
+{
+    for (uint32_t slot = getSlot(state); indexOffsets[slot] != NO_OFFSET; slot = (slot + 1) % INDEX_SIZE)
+        if (indexStates[slot] == state) return indexOffsets[slot];
+
+    return std::nullopt;
+}
+
+uint32_t RngLookahead::getMaxProfit(uint32_t customers, uint32_t offset) const
+{
+    if (offset >= PROFIT_ROWS) return customers * getProfit(Item::MEDICINE, Offer::PLUS_50);
+
+    return maxProfits[customers * PROFIT_ROWS + offset];
+}
+
+int32_t RngLookahead::getMinimumBuys(const MonochromeShop& shop, int32_t remainingProfit) const
+{
+    if (remainingProfit <= 0) return 0;
+
+    auto offset = getOffset(shop.getRngState());
+    if (!offset) return 0;
+
+    // the current customer takes at least one more draw, so the next one can't spawn before the next offset
+    const int32_t current   = getProfit(shop.getCustomer().item, Offer::PLUS_50);
+    const uint32_t upcoming = std::min(shop.getRemainingCustomers(), LOOKAHEAD_CUSTOMERS);
+    const uint32_t next     = *offset + 1;
+
+    for (uint32_t buys = 1; buys <= upcoming + 1; buys++)
+    {
+        int32_t withCurrent    = current + getMaxProfit(buys - 1, next);
+        int32_t withoutCurrent = buys <= upcoming ? getMaxProfit(buys, next) : 0;
+        if (std::max(withCurrent, withoutCurrent) >= remainingProfit) return buys;
+    }
+
+    return upcoming + 2;
+}
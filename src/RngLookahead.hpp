@@ -0,0 +1,42 @@
+#pragma once
+#include "MonochromeShop.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+constexpr uint32_t LOOKAHEAD_WINDOW    = 1024; // draws past the seed the lookahead knows about
+constexpr uint32_t LOOKAHEAD_CUSTOMERS = 20;
+constexpr int32_t LOOKAHEAD_SLACK      = 8; // spare customers beyond which the window never allows fewer buys
+
+/*
+ * Precomputed knowledge about the customers that can spawn along the RNG stream of a seed.
+ *
+ * A customer spawning at draw offset k is decided by draws k and k + 1 and needs at least one more draw
+ * to buy, so the next one spawns at k + 3 or later. With the item of every possible spawn known, this gives
+ * the most profit any number of customers can still make from a given point of the stream.
+ */
+class RngLookahead
+{
+private:
+    static constexpr uint32_t INDEX_SIZE = 4096; // open addressing, power of two and > 2 * LOOKAHEAD_WINDOW
+    static constexpr uint16_t NO_OFFSET  = 0xFFFF;
+
+    std::vector<uint32_t> indexStates;
+    std::vector<uint16_t> indexOffsets;
+    std::vector<uint16_t> maxProfits; // [customers][offset]
+
+    static uint32_t getSlot(uint32_t state);
+
+public:
+    explicit RngLookahead(uint32_t seed);
+
+    [[nodiscard]] std::optional<uint32_t> getOffset(uint32_t state) const;
+    [[nodiscard]] uint32_t getMaxProfit(uint32_t customers, uint32_t offset) const;
+
+    /*
+     * Lowest number of buys, including the current customer, that can still make the given profit.
+     * Returns more than the remaining customers if that's impossible and 0 if the state is outside the window.
+     */
+    [[nodiscard]] int32_t getMinimumBuys(const MonochromeShop& shop, int32_t remainingProfit) const;
+};
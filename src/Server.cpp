@@ -0,0 +1,492 @@
+#include "Server.hpp"
+
+#include <iostream>
+
+#ifdef _WIN32
+
+int serve(const std::string&, const SolveSettings&)
+{
+    std::cerr << "--serve is not supported on Windows\n";
+    return 1;
+}
+
+#else
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace std::chrono;
+
+    class Connection
+    {
+    private:
+        int fd;
+        std::mutex writeMutex;
+        std::atomic_bool open = true;
+
+    public:
+        std::atomic_bool done = false; // the reader is finished with it
+
+        explicit Connection(int fd)
+            : fd(fd)
+        {
+        }
+
+        ~Connection() { ::close(fd); }
+
+        int getFd() const { return fd; }
+        bool isOpen() const { return open; }
+
+        // writes whole lines only, so that events of concurrent solves never interleave
+        void send(const std::string& lines)
+        {
+            std::scoped_lock lock(writeMutex);
+
+            size_t written = 0;
+            while (open && written < lines.size())
+            {
+                auto count = ::send(fd, lines.data() + written, lines.size() - written, 0);
+                if (count <= 0)
+                    open = false;
+                else
+                    written += count;
+            }
+        }
+
+        void shutdown()
+        {
+            open = false;
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    };
+
+    /*
+     * Collects the output of a solve and hands it to the connection on every flush, i.e. once per event.
+     */
+    class ConnectionBuffer : public std::stringbuf
+    {
+    private:
+        Connection& connection;
+
+    protected:
+        int sync() override
+        {
+            connection.send(str());
+            str("");
+            return 0;
+        }
+
+    public:
+        explicit ConnectionBuffer(Connection& connection)
+            : connection(connection)
+        {
+        }
+    };
+
+    struct Request
+    {
+        std::string id;
+        SolveSettings settings;
+        std::shared_ptr<Connection> connection;
+        std::stop_source stopSource;
+        std::atomic_bool cancelled = false;
+        bool announced             = false; // the queued event is out, guarded by the server mutex
+    };
+
+    std::optional<uint32_t> parseNumber(const std::string& input)
+    {
+        uint32_t value;
+        auto [end, error] = std::from_chars(input.data(), input.data() + input.size(), value);
+        if (error != std::errc() || end != input.data() + input.size()) return std::nullopt;
+
+        return value;
+    }
+
+    // ids get written into JSON as they are, so keep them to what needs no escaping
+    bool isValidId(const std::string& id)
+    {
+        auto isIdChar = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_'; };
+        return !id.empty() && id.size() <= 64 && std::ranges::all_of(id, isIdChar);
+    }
+
+    bool isSocket(const std::string& path)
+    {
+        struct stat status;
+        return ::lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode);
+    }
+
+    std::string event(const std::string& id, const std::string& type, const std::string& fields = "")
+    {
+        return std::format(R"({{"id":"{}","event":"{}"{}}})", id, type, fields) + "\n";
+    }
+
+    class Server
+    {
+    private:
+        struct Client
+        {
+            std::shared_ptr<Connection> connection;
+            std::thread reader;
+        };
+
+        SolveSettings defaults;
+        SolveCache cache;
+
+        std::mutex mutex;
+        std::condition_variable queueChanged;
+        std::deque<std::shared_ptr<Request>> queue;
+        std::vector<std::shared_ptr<Request>> running;
+        bool shuttingDown = false;
+        uint64_t nextId   = 1;
+
+        std::vector<std::thread> workers;
+        std::vector<Client> clients;
+
+        void work();
+        void solveRequest(Request& request);
+        void read(std::shared_ptr<Connection> connection);
+        void handle(const std::shared_ptr<Connection>& connection, const std::string& line);
+        void enqueue(const std::shared_ptr<Connection>& connection, std::istringstream& arguments);
+        void cancel(const std::shared_ptr<Connection>& connection, const std::string& id);
+        void cancelAll(const std::shared_ptr<Connection>& connection);
+        void pruneClients();
+
+    public:
+        explicit Server(const SolveSettings& defaults)
+            : defaults(defaults)
+        {
+        }
+
+        int run(const std::string& path);
+    };
+
+    int Server::run(const std::string& path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            std::cerr << "Socket path " << path << " is too long\n";
+            return 1;
+        }
+        std::ranges::copy(path, address.sun_path);
+
+        // a socket there is left over from an earlier run that didn't shut down cleanly, anything else is a typo
+        if (isSocket(path))
+            ::unlink(path.c_str());
+        else if (::access(path.c_str(), F_OK) == 0)
+        {
+            std::cerr << path << " already exists and isn't a socket\n";
+            return 1;
+        }
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listener, SOMAXCONN) != 0)
+        {
+            std::cerr << "Can't listen on " << path << ": " << std::strerror(errno) << "\n";
+            if (listener >= 0) ::close(listener);
+            return 1;
+        }
+
+        // clients going away mid-write must not take the server with them
+        std::signal(SIGPIPE, SIG_IGN);
+
+        for (uint32_t i = 0; i < SERVER_WORKERS; i++)
+            workers.emplace_back(&Server::work, this);
+
+        std::cerr << "Listening on " << path << "\n";
+
+        while (!stop)
+        {
+            pruneClients();
+
+            pollfd poller = { .fd = listener, .events = POLLIN, .revents = 0 };
+            if (::poll(&poller, 1, static_cast<int>(SERVER_POLL_INTERVAL.count())) <= 0) continue;
+
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) continue;
+
+            auto connection = std::make_shared<Connection>(fd);
+            clients.push_back({ connection, std::thread(&Server::read, this, connection) });
+        }
+
+        {
+            std::scoped_lock lock(mutex);
+            shuttingDown = true;
+            queue.clear();
+            for (auto& request : running)
+                request->stopSource.request_stop();
+        }
+        queueChanged.notify_all();
+        std::ranges::for_each(workers, [](auto& worker) { worker.join(); });
+
+        for (auto& client : clients)
+        {
+            client.connection->shutdown();
+            client.reader.join();
+        }
+
+        ::close(listener);
+        if (isSocket(path)) ::unlink(path.c_str());
+        return 0;
+    }
+
+    void Server::pruneClients()
+    {
+        std::erase_if(clients,
+                      [](Client& client)
+                      {
+                          if (!client.connection->done) return false;
+
+                          client.reader.join();
+                          return true;
+                      });
+    }
+
+    void Server::work()
+    {
+        while (true)
+        {
+            std::shared_ptr<Request> request;
+            {
+                std::unique_lock lock(mutex);
+                // a request only gets started once its queued event is out, its events must come after that one
+                auto announced = [](const auto& queued) { return queued->announced; };
+                queueChanged.wait(lock, [&] { return shuttingDown || std::ranges::any_of(queue, announced); });
+                if (shuttingDown) return;
+
+                auto it = std::ranges::find_if(queue, announced);
+                request = *it;
+                queue.erase(it);
+                running.push_back(request);
+            }
+
+            solveRequest(*request);
+
+            std::scoped_lock lock(mutex);
+            std::erase(running, request);
+        }
+    }
+
+    void Server::solveRequest(Request& request)
+    {
+        ConnectionBuffer buffer(*request.connection);
+        std::ostream stream(&buffer);
+        auto output = createOutput(OutputFormat::NDJSON, stream, request.id);
+
+        output->start(toParameters(request.settings));
+        auto start = steady_clock::now();
+        auto best  = solve(request.settings, cache, output.get(), request.stopSource.get_token());
+
+        if (best.isStopped() || stop)
+        {
+            auto reason = request.cancelled ? "cancel" : stop ? "shutdown" : "time";
+            request.connection->send(event(request.id, "stopped", std::format(R"(,"reason":"{}")", reason)));
+        }
+        output->finished(best.getResults(), duration_cast<milliseconds>(steady_clock::now() - start));
+    }
+
+    void Server::read(std::shared_ptr<Connection> connection)
+    {
+        std::string pending;
+        char buffer[1024];
+
+        while (connection->isOpen())
+        {
+            auto count = ::recv(connection->getFd(), buffer, sizeof(buffer), 0);
+            if (count <= 0) break;
+
+            pending.append(buffer, count);
+            for (auto end = pending.find('\n'); end != std::string::npos; end = pending.find('\n'))
+            {
+                std::string line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+
+                handle(connection, line);
+            }
+
+            if (pending.size() > SERVER_MAX_LINE) break;
+        }
+
+        // nobody is left to read the results
+        cancelAll(connection);
+        connection->done = true;
+    }
+
+    void Server::handle(const std::shared_ptr<Connection>& connection, const std::string& line)
+    {
+        std::istringstream arguments(line);
+        std::string command;
+        if (!(arguments >> command)) return;
+
+        if (command == "solve")
+            enqueue(connection, arguments);
+        else if (command == "cancel")
+        {
+            std::string id;
+            arguments >> id;
+            if (id.starts_with("id=")) id = id.substr(3);
+
+            cancel(connection, id);
+        }
+        else
+            connection->send(R"({"event":"error","reason":"unknown command"})" "\n");
+    }
+
+    /*
+     * solve seed=<seed> [id=<id>] [advances=<n>] [attempts=<n>] [depth=<n>] [score=<n>] [top=<n>] [mode=<mode>]
+     *       [time=<ms>]
+     */
+    void Server::enqueue(const std::shared_ptr<Connection>& connection, std::istringstream& arguments)
+    {
+        auto request        = std::make_shared<Request>();
+        request->settings   = defaults;
+        request->connection = connection;
+
+        std::string error;
+        bool hasSeed = false;
+        std::string argument;
+        while (error.empty() && arguments >> argument)
+        {
+            auto separator = argument.find('=');
+            auto key       = argument.substr(0, separator);
+            auto value     = separator == std::string::npos ? "" : argument.substr(separator + 1);
+            auto number    = parseNumber(value);
+
+            if (key == "id")
+            {
+                if (isValidId(value))
+                    request->id = value;
+                else
+                    error = "invalid id";
+            }
+            else if (key == "mode")
+            {
+                if (value == "combined" || value == "deep" || value == "heuristic" || value == "macro")
+                    request->settings.mode = convertMode(value);
+                else
+                    error = "invalid mode";
+            }
+            else if (!number)
+                error = isValidId(key) ? std::format("invalid {}", key) : "invalid argument";
+            else if (key == "seed")
+            {
+                request->settings.seed = *number;
+                hasSeed                = true;
+            }
+            else if (key == "advances")
+                request->settings.advances = *number;
+            else if (key == "attempts")
+                request->settings.attempts = *number;
+            else if (key == "depth")
+                request->settings.depth = static_cast<int32_t>(*number);
+            else if (key == "score")
+                request->settings.score = *number;
+            else if (key == "top")
+                request->settings.top = *number;
+            else if (key == "time")
+                request->settings.timeLimit = milliseconds(*number);
+            else
+                error = isValidId(key) ? std::format("unknown option {}", key) : "invalid argument";
+        }
+
+        if (error.empty() && !hasSeed) error = "missing seed";
+
+        std::unique_lock lock(mutex);
+        if (request->id.empty()) request->id = std::to_string(nextId++);
+
+        auto sameId = [&](const auto& other) { return other->connection == connection && other->id == request->id; };
+        if (error.empty() && (std::ranges::any_of(queue, sameId) || std::ranges::any_of(running, sameId)))
+            error = "duplicate id";
+        if (error.empty() && queue.size() >= SERVER_QUEUE_SIZE) error = "queue full";
+
+        if (!error.empty())
+        {
+            lock.unlock();
+            connection->send(event(request->id, "rejected", std::format(R"(,"reason":"{}")", error)));
+            return;
+        }
+
+        // sent without the lock, a client that doesn't read must not hold up the other connections
+        queue.push_back(request);
+        auto position = queue.size();
+        lock.unlock();
+        connection->send(event(request->id, "queued", std::format(R"(,"position":{})", position)));
+
+        lock.lock();
+        request->announced = true;
+        lock.unlock();
+        queueChanged.notify_all();
+    }
+
+    void Server::cancel(const std::shared_ptr<Connection>& connection, const std::string& id)
+    {
+        std::unique_lock lock(mutex);
+
+        auto sameId = [&](const auto& other) { return other->connection == connection && other->id == id; };
+        if (auto it = std::ranges::find_if(running, sameId); it != running.end())
+        {
+            (*it)->cancelled = true;
+            (*it)->stopSource.request_stop();
+            return; // the worker reports it, along with the results found so far
+        }
+
+        auto it = std::ranges::find_if(queue, sameId);
+        bool found = it != queue.end();
+        if (found) queue.erase(it);
+        lock.unlock();
+
+        auto safeId = isValidId(id) ? id : "";
+        if (found)
+            connection->send(event(safeId, "stopped", R"(,"reason":"cancel")"));
+        else
+            connection->send(event(safeId, "error", R"(,"reason":"unknown id")"));
+    }
+
+    void Server::cancelAll(const std::shared_ptr<Connection>& connection)
+    {
+        std::scoped_lock lock(mutex);
+
+        std::erase_if(queue, [&](const auto& request) { return request->connection == connection; });
+        for (auto& request : running)
+        {
+            if (request->connection != connection) continue;
+
+            request->cancelled = true;
+            request->stopSource.request_stop();
+        }
+    }
+} // namespace
+
+int serve(const std::string& path, const SolveSettings& defaults)
+{
+    Server server(defaults);
+    return server.run(path);
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include "Solver.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+constexpr size_t SERVER_QUEUE_SIZE  = 16;      // requests waiting for a worker, any more get rejected
+constexpr uint32_t SERVER_WORKERS   = 2;       // requests solved at the same time
+constexpr size_t SERVER_MAX_LINE    = 1 << 12; // longest request line before the connection gets dropped
+constexpr auto SERVER_POLL_INTERVAL = std::chrono::milliseconds(200);
+
+/*
+ * Answers solve requests on a Unix domain socket until ctrl+C, with the given settings as defaults for them.
+ * All requests share one SolveCache, so repeated seeds and spawn states come out of it warm.
+ * Returns the exit code.
+ */
+int serve(const std::string& path, const SolveSettings& defaults);
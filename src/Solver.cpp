@@ -0,0 +1,559 @@
+#include "Solver.hpp"
+
+#include "Frontier.hpp"
+#include "MonochromeShop.hpp"
+#include "Parallel.hpp"
+#include "Portfolio.hpp"
+#include "RngLookahead.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+std::atomic_bool stop = false;
+
+namespace
+{
+    bool isStopped(const BestResult& best_result)
+    {
+        return stop || best_result.isStopped();
+    }
+
+    // helpers of the combined solve also stop once there is no deep solver left to help
+    bool isStopped(const BestResult& best_result, const std::stop_token& helpers)
+    {
+        return isStopped(best_result) || helpers.stop_requested();
+    }
+
+    // a finished solve doesn't depend on how much time it was given
+    SolveSettings withoutTimeLimit(SolveSettings settings)
+    {
+        settings.timeLimit = {};
+        return settings;
+    }
+
+    /*
+     * Solve logic
+     */
+
+    /*
+     * Plain depth-first search over the lazy children, best bound first. A route found in the first child prunes its
+     * siblings right away, which the breadth-first frontier only gets to on the next level.
+     */
+    template<typename Costs>
+    void depthFirstSolve(const FullSolveEntry<Costs>& node, BestResult& best_result, int32_t levels)
+    {
+        if (levels == 0 || isStopped(best_result)) return;
+
+        typename FullSolveEntry<Costs>::Children children(node, best_result);
+        while (auto child = children.next(best_result))
+            depthFirstSolve(*child, best_result, levels - 1);
+    }
+
+    template<typename Costs>
+    void deepSolve(FullSolveEntry<Costs> root, BestResult& best_result, int32_t max_depth, int32_t chunk_depth)
+    {
+        if (isStopped(best_result)) return;
+
+        int32_t currentDepth = root.getInputs().size();
+        int32_t iterations   = std::min(chunk_depth, max_depth - currentDepth);
+
+        if (iterations == 0) return;
+
+        // a tree that fits in one chunk has nothing to split its frontier levels over on a single core, so it goes
+        // depth-first like the last chunk of a bigger one. Children never get here, their parent decides for them.
+        if (iterations == max_depth - currentDepth && std::thread::hardware_concurrency() <= 1)
+        {
+            TraceSpan frame("depthFirstSolve", "depth", currentDepth);
+            depthFirstSolve(root, best_result, iterations);
+            return;
+        }
+
+        TraceSpan frame("deepSolve", "depth", currentDepth);
+
+        Frontier<Costs> frontier(root);
+        for (int32_t i = 0; i < iterations; i++)
+        {
+            if (isStopped(best_result)) return;
+
+            TraceSpan level("BFS level", "nodes");
+            frontier.expand(best_result);
+            level.setArg(frontier.size());
+        }
+
+        // the last chunk above the depth limit goes depth-first, its subtrees are small and gain the most from pruning.
+        // Decided here rather than in the child frame, so that the root keeps its frontier for the parallel levels.
+        int32_t remaining = max_depth - currentDepth - iterations;
+        for (auto index : frontier.sortByBound())
+        {
+            if (isStopped(best_result)) return;
+
+            if (remaining > chunk_depth)
+                deepSolve(frontier.materialize(index), best_result, max_depth, chunk_depth);
+            else
+            {
+                TraceSpan subtree("depthFirstSolve", "depth", currentDepth + iterations);
+                depthFirstSolve(frontier.materialize(index), best_result, remaining);
+            }
+        }
+    }
+
+    template<typename Costs>
+    void macroSolve(const FullSolveEntry<Costs>& node, BestResult& best_result, MacroEdgeCache<Costs>& cache)
+    {
+        if (isStopped(best_result)) return;
+
+        auto shop = node.getShop();
+        if (shop.hasEnded())
+        {
+            if (shop.getProfits() >= REQUIRED_PROFITS && node.getScore() < best_result.getCachedScore())
+                best_result.updateScore(node);
+
+            return;
+        }
+
+        if (node.getBestPossibleScore() >= best_result.getCachedScore()) return;
+
+        struct Child
+        {
+            const MacroEdge* edge;
+            uint32_t bound;
+        };
+
+        // bound every edge on a bare shop first, only the visited ones get a full entry
+        auto edges = cache.get(shop);
+        std::vector<Child> children;
+        for (auto& edge : *edges)
+        {
+            MonochromeShop child = shop;
+            for (auto input : edge.inputs)
+                child.input(input);
+
+            uint32_t score = node.getScore() + edge.cost;
+            uint32_t bound = FullSolveEntry<Costs>::getBestPossibleScore(child, score, node.getLookahead());
+            children.push_back({ &edge, bound });
+        }
+
+        std::ranges::stable_sort(children, {}, &Child::bound);
+
+        for (auto& child : children)
+        {
+            if (child.bound >= best_result.getCachedScore()) break;
+
+            FullSolveEntry<Costs> next = node;
+            for (auto input : child.edge->inputs)
+                next.apply(input);
+
+            macroSolve(next, best_result, cache);
+        }
+    }
+
+    // returns the best score among the attempts, whether it beat the bound or not
+    template<typename Costs>
+    uint32_t heuristicBatch(uint32_t seed,
+                            uint32_t attempts,
+                            uint32_t advances,
+                            BestResult& best_result,
+                            const std::stop_token& helpers = {})
+    {
+        TraceSpan span("heuristic batch", "advances", advances);
+
+        uint32_t found = IMPOSSIBLE_SCORE;
+        for (uint32_t j = 0; j < attempts && !isStopped(best_result, helpers); j++)
+        {
+            HeuristicSolveEntry<Costs> entry(seed, advances);
+            entry.next(best_result);
+            if (entry.getShop().getProfits() >= REQUIRED_PROFITS) found = std::min(found, entry.getScore());
+        }
+
+        return found;
+    }
+
+    template<typename Costs>
+    void heuristicSolve(uint32_t seed, uint32_t attempts, uint32_t advances, BestResult& best_result)
+    {
+        for (uint32_t j = 0; j < attempts && !isStopped(best_result); j += HEURISTIC_BATCH)
+            heuristicBatch<Costs>(seed, std::min(attempts - j, HEURISTIC_BATCH), advances, best_result);
+    }
+
+    /*
+     * Breadth-first search that only keeps the width nodes with the best bound on every level. Not exhaustive, but
+     * it finds good routes fast, which tightens the bound for the deep solver. Returns the best score it found.
+     */
+    template<typename Costs>
+    uint32_t beamSolve(const FullSolveEntry<Costs>& root,
+                       uint32_t width,
+                       BestResult& best_result,
+                       int32_t max_depth,
+                       const std::stop_token& helpers)
+    {
+        TraceSpan span("beam", "width", width);
+
+        uint32_t found = IMPOSSIBLE_SCORE;
+        auto depth     = static_cast<int32_t>(root.getInputs().size());
+        std::vector<FullSolveEntry<Costs>> level = { root };
+
+        while (!level.empty() && depth++ < max_depth && !isStopped(best_result, helpers))
+        {
+            std::vector<FullSolveEntry<Costs>> next;
+            for (auto& entry : level)
+            {
+                if (isStopped(best_result, helpers)) break;
+
+                for (auto& child : entry.next(best_result))
+                {
+                    auto shop = child.getShop();
+                    if (!shop.hasEnded())
+                        next.push_back(std::move(child));
+                    else if (shop.getProfits() >= REQUIRED_PROFITS)
+                    {
+                        found = std::min(found, child.getScore());
+                        child.next(best_result);
+                    }
+                }
+            }
+
+            std::ranges::stable_sort(next,
+                                     [](const auto& a, const auto& b)
+                                     { return a.getBestPossibleScore() < b.getBestPossibleScore(); });
+            if (next.size() > width) next.erase(next.begin() + width, next.end());
+
+            level = std::move(next);
+        }
+
+        return found;
+    }
+
+    /*
+     * Helper thread of a combined solve, spends its time on whatever the portfolio says lowers the bound the most,
+     * until it's all up to the deep solver or the deep solvers are done.
+     */
+    template<typename Costs>
+    void portfolioSolve(const SolveSettings& settings,
+                        uint32_t advances,
+                        const RngLookahead& lookahead,
+                        Portfolio& portfolio,
+                        BestResult& best_result,
+                        std::stop_token helpers)
+    {
+        FullSolveEntry<Costs> root(settings.seed, advances, &lookahead);
+        uint32_t width = BEAM_WIDTH;
+
+        while (!isStopped(best_result, helpers))
+        {
+            auto strategy = portfolio.pick();
+            if (strategy == Strategy::DEEP) return;
+
+            auto bound = best_result.getScore();
+            auto start = std::chrono::steady_clock::now();
+
+            uint32_t found;
+            if (strategy == Strategy::HEURISTIC)
+                found = heuristicBatch<Costs>(settings.seed, HEURISTIC_BATCH, advances, best_result, helpers);
+            else
+            {
+                found = beamSolve(root, width, best_result, settings.depth, helpers);
+                width = std::min(width * 2, MAX_BEAM_WIDTH);
+            }
+
+            portfolio.report(strategy, std::chrono::steady_clock::now() - start, found < bound ? bound - found : 0);
+        }
+    }
+
+    template<typename Costs>
+    void startSolvers(TaskGroup& tasks,
+                      const SolveSettings& settings,
+                      SolveCache& cache,
+                      const RngLookahead& lookahead,
+                      Portfolio& portfolio,
+                      std::stop_source& helpers,
+                      BestResult& result)
+    {
+        auto mode = settings.mode;
+
+        if (mode == Mode::COMBINED)
+        {
+            for (uint32_t i = 0; i <= settings.advances; i++)
+            {
+                tasks.run([&, i, token = helpers.get_token()]
+                          { portfolioSolve<Costs>(settings, i, lookahead, portfolio, result, token); });
+            }
+        }
+
+        if (mode == Mode::HEURISTIC || mode == Mode::MACRO)
+        {
+            for (uint32_t i = 0; i <= settings.advances; i++)
+                tasks.run([&, i] { heuristicSolve<Costs>(settings.seed, settings.attempts, i, result); });
+        }
+
+        if (mode == Mode::COMBINED || mode == Mode::DEEP)
+        {
+            // the last deep solver to finish retires the helpers, whatever they'd find now is covered already
+            auto running = std::make_shared<std::atomic_uint32_t>(settings.advances + 1);
+
+            for (uint32_t i = 0; i <= settings.advances; i++)
+            {
+                tasks.run(
+                    [&, running, entry = FullSolveEntry<Costs>(settings.seed, i, &lookahead)]
+                    {
+                        deepSolve(entry, result, settings.depth, settings.chunkDepth);
+                        if (--*running == 0) helpers.request_stop();
+                    });
+            }
+        }
+
+        if (mode == Mode::MACRO)
+        {
+            // shared by all advances, their spawn states tend to overlap
+            auto edges = cache.getMacroEdges<Costs>(settings.macroLimits);
+
+            for (uint32_t i = 0; i <= settings.advances; i++)
+            {
+                tasks.run([edges, &result, entry = FullSolveEntry<Costs>(settings.seed, i, &lookahead)]
+                          { macroSolve(entry, result, *edges); });
+            }
+        }
+    }
+
+    template<typename Costs>
+    void expandRootsOf(const SolveSettings& settings,
+                       const RngLookahead& lookahead,
+                       BestResult& result,
+                       const std::function<void(const std::vector<Input>&)>& callback)
+    {
+        for (uint32_t i = 0; i <= settings.advances && !isStopped(result); i++)
+        {
+            FullSolveEntry<Costs> root(settings.seed, i, &lookahead);
+
+            auto depth         = static_cast<int32_t>(root.getInputs().size());
+            int32_t iterations = std::min(settings.chunkDepth, settings.depth - depth);
+            if (iterations <= 0) continue;
+
+            Frontier<Costs> frontier(root);
+            for (int32_t j = 0; j < iterations && frontier.size() < SPLIT_ROOTS && !isStopped(result); j++)
+                frontier.expand(result);
+
+            for (auto index : frontier.sortByBound())
+            {
+                if (isStopped(result)) return;
+
+                std::vector<Input> inputs;
+                for (auto& val : frontier.materialize(index).getInputs())
+                    inputs.push_back(val.input);
+
+                callback(inputs);
+            }
+        }
+    }
+
+    template<typename Costs>
+    void solveRootsOf(const SolveSettings& settings,
+                      const RngLookahead& lookahead,
+                      const std::vector<std::vector<Input>>& roots,
+                      BestResult& result)
+    {
+        for (auto& inputs : roots)
+        {
+            if (isStopped(result)) return;
+
+            auto first    = std::ranges::find_if(inputs, [](Input input) { return input != Input::CATCH_UP; });
+            auto advances = static_cast<uint32_t>(first - inputs.begin());
+
+            FullSolveEntry<Costs> root(settings.seed, advances, &lookahead);
+            for (size_t i = advances; i < inputs.size(); i++)
+                root.apply(inputs[i]);
+
+            deepSolve(root, result, settings.depth, settings.chunkDepth);
+        }
+    }
+} // namespace
+
+/*
+ * SolveCache implementation
+ */
+
+template<typename Costs>
+std::shared_ptr<MacroEdgeCache<Costs>> SolveCache::getMacroEdges(MacroLimits limits)
+{
+    std::scoped_lock lock(mutex);
+
+    auto& cache = [this]() -> EdgeCache<Costs>&
+    {
+        if constexpr (std::is_same_v<Costs, DefaultCosts>)
+            return defaultEdges;
+        else
+            return dynamicEdges;
+    }();
+
+    // edges are only valid for the limits and costs they were enumerated with
+    if (!cache.edges || cache.limits != limits || cache.costs != Costs::get())
+    {
+        cache.limits = limits;
+        cache.costs  = Costs::get();
+        cache.edges  = std::make_shared<MacroEdgeCache<Costs>>(limits);
+    }
+
+    return cache.edges;
+}
+
+std::optional<std::vector<ISolveEntry>> SolveCache::findResults(const SolveSettings& settings)
+{
+    std::scoped_lock lock(mutex);
+
+    auto key = withoutTimeLimit(settings);
+    for (auto& [stored, entries] : results)
+        if (stored == key) return entries;
+
+    return std::nullopt;
+}
+
+void SolveCache::storeResults(const SolveSettings& settings, const std::vector<ISolveEntry>& entries)
+{
+    std::scoped_lock lock(mutex);
+
+    if (results.size() >= RESULT_STORE_SIZE) results.pop_front();
+    results.emplace_back(withoutTimeLimit(settings), entries);
+}
+
+template std::shared_ptr<MacroEdgeCache<DefaultCosts>> SolveCache::getMacroEdges(MacroLimits limits);
+template std::shared_ptr<MacroEdgeCache<DynamicCosts>> SolveCache::getMacroEdges(MacroLimits limits);
+
+/*
+ * StopTimer implementation
+ */
+
+StopTimer::StopTimer(std::stop_source source, std::chrono::milliseconds limit)
+{
+    if (limit.count() <= 0) return;
+
+    timer.run(
+        [this, source, limit]() mutable
+        {
+            std::unique_lock lock(mutex);
+            if (!condition.wait_for(lock, limit, [this] { return finished; })) source.request_stop();
+        });
+}
+
+StopTimer::~StopTimer()
+{
+    {
+        std::scoped_lock lock(mutex);
+        finished = true;
+    }
+    condition.notify_all();
+    timer.wait();
+}
+
+/*
+ * Solve implementation
+ */
+
+BestResult solve(const SolveSettings& settings, SolveCache& cache, SolveOutput* output, std::stop_token stopToken)
+{
+    // both the caller and the time limit can stop the solve
+    std::stop_source source;
+    std::stop_callback forward(stopToken, [&source] { source.request_stop(); });
+
+    BestResult result(settings.score, settings.top, source.get_token());
+
+    // heuristic results are random, everything else comes out the same every time
+    bool exhaustive = settings.mode != Mode::HEURISTIC;
+    if (exhaustive)
+    {
+        if (auto entries = cache.findResults(settings))
+        {
+            for (auto& entry : *entries)
+                result.updateScore(entry);
+
+            return result;
+        }
+    }
+
+    RngLookahead lookahead(settings.seed);
+
+    {
+        std::optional<BestResultReporter> reporter;
+        if (output) reporter.emplace(result, *output);
+        TaskGroup solvers;
+        std::stop_source helpers;
+
+        // the helpers of the combined mode share --attempts per advance
+        Portfolio portfolio(static_cast<uint64_t>(settings.attempts) * (settings.advances + 1));
+
+        // the solvers read the cost profile until they are done, so they have to finish within withCosts
+        auto started = withCosts(
+            settings.costs,
+            [&]<typename Costs>(Costs)
+            {
+                startSolvers<Costs>(solvers, settings, cache, lookahead, portfolio, helpers, result);
+
+                StopTimer timer(source, settings.timeLimit);
+                solvers.wait();
+            });
+        if (!started) source.request_stop();
+    }
+
+    if (exhaustive && !isStopped(result)) cache.storeResults(settings, result.getResults());
+
+    return result;
+}
+
+bool expandRoots(const SolveSettings& settings,
+                 BestResult& result,
+                 const std::function<void(const std::vector<Input>&)>& callback)
+{
+    RngLookahead lookahead(settings.seed);
+    return withCosts(settings.costs,
+                     [&]<typename Costs>(Costs) { expandRootsOf<Costs>(settings, lookahead, result, callback); });
+}
+
+bool solveRoots(const SolveSettings& settings, const std::vector<std::vector<Input>>& roots, BestResult& result)
+{
+    RngLookahead lookahead(settings.seed);
+    return withCosts(settings.costs,
+                     [&]<typename Costs>(Costs) { solveRootsOf<Costs>(settings, lookahead, roots, result); });
+}
+
+SolveParameters toParameters(const SolveSettings& settings)
+{
+    return {
+        .seed     = settings.seed,
+        .advances = settings.advances,
+        .attempts = settings.attempts,
+        .score    = settings.score,
+        .depth    = static_cast<uint32_t>(settings.depth),
+        .top      = settings.top,
+        .mode     = convertMode(settings.mode),
+    };
+}
+
+/*
+ * Enum -> String conversion helper
+ */
+
+Mode convertMode(std::string input)
+{
+    if (input == "combined") return Mode::COMBINED;
+    if (input == "deep") return Mode::DEEP;
+    if (input == "heuristic") return Mode::HEURISTIC;
+    if (input == "macro") return Mode::MACRO;
+
+    return Mode::COMBINED;
+}
+
+std::string convertMode(Mode mode)
+{
+    switch (mode)
+    {
+        case Mode::COMBINED: return "combined";
+        case Mode::DEEP: return "deep";
+        case Mode::HEURISTIC: return "heuristic";
+        case Mode::MACRO: return "macro";
+    }
+
+    return "SOMETHING BROKE";
+}
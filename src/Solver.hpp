@@ -0,0 +1,137 @@
+#pragma once
+#include "CostProfile.hpp"
+#include "FullSolver.hpp"
+#include "MacroSolver.hpp"
+#include "Output.hpp"
+#include "Parallel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+constexpr size_t RESULT_STORE_SIZE = 256;     // finished solves a SolveCache remembers
+constexpr size_t SPLIT_ROOTS       = 1 << 12; // subtrees per advance expandRoots stops expanding at
+
+extern std::atomic_bool stop; // stops every solve, set on ctrl+C
+
+enum class Mode
+{
+    DEEP,
+    HEURISTIC,
+    COMBINED,
+    MACRO,
+};
+
+/*
+ * Everything a single solve depends on.
+ */
+struct SolveSettings
+{
+    uint32_t seed                       = 0;
+    uint32_t advances                   = 0;
+    uint32_t attempts                   = 0;
+    uint32_t score                      = IMPOSSIBLE_SCORE;
+    Mode mode                           = Mode::COMBINED;
+    int32_t depth                       = DEFAULT_DEPTH;
+    int32_t chunkDepth                  = SOLVE_DEPTH; // levels expanded breadth-first per deep solver frame
+    uint32_t top                        = 1;
+    CostProfile costs                   = DEFAULT_COSTS;
+    MacroLimits macroLimits             = {};
+    std::chrono::milliseconds timeLimit = {}; // none when zero
+
+    bool operator==(const SolveSettings& other) const = default;
+};
+
+/*
+ * State that stays valid from one solve to the next: the macro edges of every spawn state seen so far and the
+ * results of solves that ran to completion. Sharing one between solves, like the server does, lets them start warm.
+ */
+class SolveCache
+{
+private:
+    template<typename Costs>
+    struct EdgeCache
+    {
+        MacroLimits limits;
+        CostProfile costs;
+        std::shared_ptr<MacroEdgeCache<Costs>> edges;
+    };
+
+    std::mutex mutex;
+    EdgeCache<DefaultCosts> defaultEdges;
+    EdgeCache<DynamicCosts> dynamicEdges;
+    std::deque<std::pair<SolveSettings, std::vector<ISolveEntry>>> results;
+
+public:
+    template<typename Costs>
+    std::shared_ptr<MacroEdgeCache<Costs>> getMacroEdges(MacroLimits limits);
+
+    std::optional<std::vector<ISolveEntry>> findResults(const SolveSettings& settings);
+    void storeResults(const SolveSettings& settings, const std::vector<ISolveEntry>& results);
+};
+
+/*
+ * Requests a stop on the given source once the time limit is up, unless it goes out of scope first. Does nothing
+ * for a limit of zero.
+ */
+class StopTimer
+{
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool finished = false;
+    TaskGroup timer;
+
+public:
+    StopTimer(std::stop_source source, std::chrono::milliseconds limit);
+    ~StopTimer();
+
+    StopTimer(const StopTimer&)            = delete;
+    StopTimer& operator=(const StopTimer&) = delete;
+};
+
+/*
+ * Runs a solve with the given settings until it's exhausted, the time limit is hit or the stop token triggers.
+ * Check isStopped() on the returned result to tell whether it ran to completion, it also comes back stopped when it
+ * couldn't start because of the cost profile, see withCosts.
+ */
+BestResult solve(const SolveSettings& settings,
+                 SolveCache& cache,
+                 SolveOutput* output       = nullptr,
+                 std::stop_token stopToken = {});
+
+/*
+ * Splits the deep solve of settings into subtrees, expanding each advance until it has SPLIT_ROOTS of them or by
+ * settings.chunkDepth levels.
+ * Calls back with every root sorted by bound, as inputs from settings.seed with the advances as leading CATCH_UPs.
+ * Routes that already end within the expanded levels go straight into the result.
+ * Returns false when it couldn't start, see withCosts.
+ */
+bool expandRoots(const SolveSettings& settings,
+                 BestResult& result,
+                 const std::function<void(const std::vector<Input>&)>& callback);
+
+/*
+ * Deep solves the subtrees below the given roots one after another, stops with the result. Unlike solve() this
+ * doesn't apply settings.timeLimit, the caller arms a StopTimer on the stop source of the result.
+ * Returns false when it couldn't start, see withCosts.
+ */
+bool solveRoots(const SolveSettings& settings, const std::vector<std::vector<Input>>& roots, BestResult& result);
+
+SolveParameters toParameters(const SolveSettings& settings);
+
+/*
+ * Enum -> String conversion helper
+ */
+
+Mode convertMode(std::string input);
+std::string convertMode(Mode mode);
@@ -0,0 +1,157 @@
+#include "Trace.hpp"
+
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic_bool tracing = false;
+
+namespace
+{
+    using namespace std::chrono;
+
+    struct Event
+    {
+        const char* name;
+        const char* argName; // no argument when null
+        uint64_t start;
+        uint64_t duration;
+        uint64_t arg;
+        bool instant;
+    };
+
+    /*
+     * Ring buffer of one thread. Pooled threads keep theirs, other threads come and go, so a lane gets handed to
+     * the next thread once its owner exits. Their events never overlap, which keeps the timeline readable.
+     */
+    struct Lane
+    {
+        uint32_t id;
+        std::vector<Event> events;
+        uint64_t count = 0;
+
+        void push(const Event& event) { events[count++ % events.size()] = event; }
+    };
+
+    const auto traceStart = steady_clock::now();
+
+    std::mutex laneMutex;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::vector<Lane*> freeLanes;
+
+    struct LaneHolder
+    {
+        Lane* lane = nullptr;
+
+        Lane& get()
+        {
+            if (lane) return *lane;
+
+            std::scoped_lock lock(laneMutex);
+            if (freeLanes.empty())
+            {
+                auto created = std::make_unique<Lane>();
+                created->id  = static_cast<uint32_t>(lanes.size() + 1);
+                created->events.resize(TRACE_BUFFER_SIZE);
+                freeLanes.push_back(created.get());
+                lanes.push_back(std::move(created));
+            }
+
+            lane = freeLanes.back();
+            freeLanes.pop_back();
+            return *lane;
+        }
+
+        ~LaneHolder()
+        {
+            if (!lane) return;
+
+            std::scoped_lock lock(laneMutex);
+            freeLanes.push_back(lane);
+        }
+    };
+
+    thread_local LaneHolder laneHolder;
+
+    std::string toJson(const Event& event, uint32_t lane)
+    {
+        auto args = event.argName ? std::format(R"(,"args":{{"{}":{}}})", event.argName, event.arg) : "";
+        auto time = std::format("{:.3f}", event.start / 1000.0);
+
+        if (event.instant)
+            return std::format(R"({{"name":"{}","ph":"i","s":"t","ts":{},"pid":1,"tid":{}{}}})",
+                               event.name,
+                               time,
+                               lane,
+                               args);
+
+        return std::format(R"({{"name":"{}","ph":"X","ts":{},"dur":{:.3f},"pid":1,"tid":{}{}}})",
+                           event.name,
+                           time,
+                           event.duration / 1000.0,
+                           lane,
+                           args);
+    }
+
+    bool writeTrace(const std::string& path)
+    {
+        std::ofstream file(path);
+        file << R"({"displayTimeUnit":"ms","traceEvents":[)" << "\n";
+        file << R"({"name":"process_name","ph":"M","pid":1,"args":{"name":"MonochromonSolver"}})";
+
+        std::scoped_lock lock(laneMutex);
+        uint64_t dropped = 0;
+        for (auto& lane : lanes)
+        {
+            file << std::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+                                "\"args\":{{\"name\":\"lane {}\"}}}}",
+                                lane->id,
+                                lane->id);
+
+            // oldest first, a full buffer continues right after the last write
+            auto size  = lane->events.size();
+            auto first = lane->count > size ? lane->count - size : 0;
+            for (auto i = first; i < lane->count; i++)
+                file << ",\n" << toJson(lane->events[i % size], lane->id);
+
+            dropped += first;
+        }
+
+        file << std::format("\n],\"otherData\":{{\"dropped_events\":{}}}}}\n", dropped);
+        return static_cast<bool>(file.flush());
+    }
+} // namespace
+
+uint64_t getTraceTime()
+{
+    return duration_cast<nanoseconds>(steady_clock::now() - traceStart).count();
+}
+
+void recordSpan(const char* name, uint64_t start, const char* argName, uint64_t arg)
+{
+    laneHolder.get().push({ name, argName, start, getTraceTime() - start, arg, false });
+}
+
+void recordInstant(const char* name, const char* argName, uint64_t arg)
+{
+    laneHolder.get().push({ name, argName, getTraceTime(), 0, arg, true });
+}
+
+/*
+ * TraceFile implementation
+ */
+
+TraceFile::TraceFile(std::string path)
+    : path(std::move(path))
+{
+    tracing = true;
+}
+
+TraceFile::~TraceFile()
+{
+    tracing = false;
+    if (!writeTrace(path)) std::cerr << "Can't write the trace to " << path << "\n";
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+constexpr size_t TRACE_BUFFER_SIZE = 1 << 16; // events per thread, older ones get overwritten
+
+extern std::atomic_bool tracing; // whether spans and instants get recorded at all
+
+uint64_t getTraceTime(); // nanoseconds since the program started
+void recordSpan(const char* name, uint64_t start, const char* argName, uint64_t arg);
+void recordInstant(const char* name, const char* argName, uint64_t arg);
+
+/*
+ * Records the time from its construction to its destruction on the timeline of the current thread.
+ * Costs a single atomic load when tracing is off.
+ */
+class TraceSpan
+{
+private:
+    const char* name;
+    const char* argName;
+    uint64_t arg;
+    uint64_t start;
+    bool active;
+
+public:
+    TraceSpan(const char* name, const char* argName = nullptr, uint64_t arg = 0)
+        : name(name)
+        , argName(argName)
+        , arg(arg)
+        , active(tracing.load(std::memory_order_relaxed))
+    {
+        start = active ? getTraceTime() : 0;
+    }
+
+    ~TraceSpan()
+    {
+        if (active) recordSpan(name, start, argName, arg);
+    }
+
+    TraceSpan(const TraceSpan&)            = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setArg(uint64_t value) { arg = value; }
+};
+
+inline void traceInstant(const char* name, const char* argName, uint64_t arg)
+{
+    if (tracing.load(std::memory_order_relaxed)) recordInstant(name, argName, arg);
+}
+
+/*
+ * Turns tracing on for its lifetime and writes everything recorded as Chrome/Perfetto trace JSON when it goes away,
+ * at which point all traced threads have to be finished.
+ */
+class TraceFile
+{
+private:
+    std::string path;
+
+public:
+    explicit TraceFile(std::string path);
+    ~TraceFile();
+};
@@ -0,0 +1,394 @@
+#include "Verifier.hpp"
+
+#include "Frontier.hpp"
+#include "MacroSolver.hpp"
+#include "Output.hpp"
+#include "RngLookahead.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <tuple>
+
+namespace
+{
+    // CATCH_UP is left out, a leading one would be read as an advance
+    constexpr Input shopInputs[] = {
+        Input::RAISE,
+        Input::RAISE_CANCEL,
+        Input::NORMAL,
+        Input::NORMAL_CANCEL,
+        Input::LOWER,
+        Input::LOWER_CANCEL,
+    };
+
+    bool endsCustomer(InputResult result)
+    {
+        return result != InputResult::CANCEL && result != InputResult::DENY && result != InputResult::ADVANCE;
+    }
+
+    std::vector<Input> toInputs(const std::vector<SolveSequenceResult>& sequence)
+    {
+        std::vector<Input> inputs;
+        for (auto& val : sequence)
+            inputs.push_back(val.input);
+
+        return inputs;
+    }
+
+    /*
+     * Fuzzing
+     */
+
+    struct Check
+    {
+        const char* name;
+        uint64_t checks     = 0;
+        uint64_t mismatches = 0;
+
+        void expect(bool ok, uint32_t seed, uint32_t advances, size_t step, std::ostream& out)
+        {
+            checks++;
+            if (ok) return;
+
+            mismatches++;
+            out << std::format("{} mismatch: seed {} advances {} step {}\n", name, seed, advances, step);
+        }
+    };
+
+    struct Checks
+    {
+        Check tables{ "tables" };
+        Check stream{ "stream" };
+        Check packed{ "packed" };
+        Check bound{ "bound" };
+        Check macro{ "macro" };
+        Check frontier{ "frontier" };
+        Check children{ "children" };
+        Check heuristic{ "heuristic" };
+    };
+
+    // every edge has to end the customer on its last input and nowhere else, for exactly the cached cost
+    bool checkMacroEdges(const MonochromeShop& shop)
+    {
+        for (auto& edge : MacroEdgeCache<DefaultCosts>::enumerate(shop, {}))
+        {
+            MonochromeShop child = shop;
+            uint32_t cost        = 0;
+            InputResult result   = InputResult::CANCEL;
+
+            for (size_t i = 0; i < edge.inputs.size(); i++)
+            {
+                if (endsCustomer(result)) return false;
+
+                SolveSequenceResult res;
+                res.input    = edge.inputs[i];
+                res.customer = child.getCustomer().type;
+                res.item     = child.getCustomer().item;
+                res.result   = result = child.input(edge.inputs[i]);
+                cost += res.getScore(DefaultCosts::get());
+            }
+
+            bool bought = result == InputResult::BUY || result == InputResult::BUY_ENDED;
+            if (!endsCustomer(result) || cost != edge.cost || bought != edge.bought ||
+                child.getProfits() - shop.getProfits() != edge.profit || child.getRngState() != edge.exitState)
+                return false;
+        }
+
+        return true;
+    }
+
+    // a bound is only meaningful for sequences that reach the profit, those must never beat it
+    void checkBounds(uint32_t seed,
+                     const std::vector<Input>& inputs,
+                     const RngLookahead& lookahead,
+                     Check& check,
+                     std::ostream& out)
+    {
+        auto reference = replay(seed, inputs);
+        if (!reference.isValid()) return;
+
+        auto first        = std::ranges::find_if(inputs, [](Input input) { return input != Input::CATCH_UP; });
+        uint32_t advances = std::distance(inputs.begin(), first);
+        FullSolveEntry<DefaultCosts> entry(seed, advances, &lookahead);
+        check.expect(entry.getBestPossibleScore() <= reference.score, seed, advances, advances, out);
+
+        for (size_t i = advances; i < inputs.size(); i++)
+        {
+            entry.apply(inputs[i]);
+            check.expect(entry.getBestPossibleScore() <= reference.score, seed, advances, i + 1, out);
+        }
+    }
+
+    void fuzzStream(uint32_t seed,
+                    uint32_t advances,
+                    const RngLookahead& lookahead,
+                    std::mt19937& rng,
+                    Checks& checks,
+                    std::ostream& out)
+    {
+        FullSolveEntry<DefaultCosts> entry(seed, advances, &lookahead);
+        std::vector<Input> inputs(advances, Input::CATCH_UP);
+
+        while (!entry.getShop().hasEnded() && inputs.size() < FUZZ_MAX_INPUTS)
+        {
+            Input input         = shopInputs[rng() % std::size(shopInputs)];
+            MonochromeShop shop = entry.getShop();
+            MonochromeShop unpacked(shop.getInitialSeed(), shop.getRngState(), shop.getPackedFields());
+
+            // fresh customers with more to come, so that their edges don't end the shop
+            if (shop.getCustomer().fails == 0 && shop.getRemainingCustomers() >= 2 && rng() % 8 == 0)
+                checks.macro.expect(checkMacroEdges(shop), seed, advances, inputs.size(), out);
+
+            bool sameResult = shop.input(input) == unpacked.input(input);
+            checks.packed.expect(sameResult && shop.getPackedFields() == unpacked.getPackedFields() &&
+                                     shop.getRngState() == unpacked.getRngState(),
+                                 seed,
+                                 advances,
+                                 inputs.size(),
+                                 out);
+
+            entry.apply(input);
+            inputs.push_back(input);
+        }
+
+        checks.stream.expect(verify(seed, entry), seed, advances, inputs.size(), out);
+        checkBounds(seed, inputs, lookahead, checks.bound, out);
+    }
+
+    // the lazy children have to be the ones of next() in order of their bound, minus the ones that are pruned
+    bool checkChildren(const FullSolveEntry<DefaultCosts>& entry)
+    {
+        BestResult best_result;
+        auto expected = entry.next(best_result);
+        std::erase_if(expected, [](auto& child) { return child.getBestPossibleScore() >= IMPOSSIBLE_SCORE; });
+        std::ranges::stable_sort(expected, {}, [](auto& child) { return child.getBestPossibleScore(); });
+
+        FullSolveEntry<DefaultCosts>::Children children(entry, best_result);
+        for (auto& child : expected)
+        {
+            auto actual = children.next(best_result);
+            if (!actual || !actual->hasSameInputs(child) || actual->getScore() != child.getScore() ||
+                actual->getBestPossibleScore() != child.getBestPossibleScore() ||
+                actual->getCustomerCount() != child.getCustomerCount() ||
+                actual->getShop().getRngState() != child.getShop().getRngState() ||
+                actual->getShop().getPackedFields() != child.getShop().getPackedFields())
+                return false;
+        }
+
+        return !children.next(best_result);
+    }
+
+    void fuzzFrontier(uint32_t seed,
+                      uint32_t advances,
+                      const RngLookahead& lookahead,
+                      Checks& checks,
+                      std::ostream& out)
+    {
+        BestResult frontierBest;
+        BestResult referenceBest;
+        FullSolveEntry<DefaultCosts> root(seed, advances, &lookahead);
+        Frontier<DefaultCosts> frontier(root);
+
+        std::vector<FullSolveEntry<DefaultCosts>> active = { root };
+        for (uint32_t i = 0; i < FUZZ_FRONTIER_LEVELS; i++)
+        {
+            frontier.expand(frontierBest);
+
+            std::vector<FullSolveEntry<DefaultCosts>> next;
+            for (auto& entry : active)
+            {
+                checks.children.expect(checkChildren(entry), seed, advances, entry.getInputs().size(), out);
+
+                auto children = entry.next(referenceBest);
+                next.insert(next.end(), children.begin(), children.end());
+            }
+            active = std::move(next);
+        }
+
+        auto key = [](const FullSolveEntry<DefaultCosts>& entry)
+        {
+            auto shop = entry.getShop();
+            return std::tuple(shop.getRngState(),
+                              shop.getPackedFields(),
+                              entry.getScore(),
+                              entry.getBestPossibleScore());
+        };
+
+        std::vector<decltype(key(root))> expected;
+        std::vector<decltype(key(root))> actual;
+        for (auto& entry : active)
+            expected.push_back(key(entry));
+
+        for (auto index : frontier.sortByBound())
+        {
+            auto entry = frontier.materialize(index);
+            checks.frontier.expect(verify(seed, entry), seed, advances, entry.getInputs().size(), out);
+            actual.push_back(key(entry));
+        }
+
+        std::ranges::sort(expected);
+        std::ranges::sort(actual);
+        checks.frontier.expect(expected == actual, seed, advances, FUZZ_FRONTIER_LEVELS, out);
+    }
+} // namespace
+
+/*
+ * Replay implementation
+ */
+
+bool Replay::isValid() const
+{
+    return ended && profit >= REQUIRED_PROFITS && unused == 0;
+}
+
+Replay replay(uint32_t seed, const std::vector<Input>& inputs, const CostProfile& costs)
+{
+    auto first        = std::ranges::find_if(inputs, [](Input input) { return input != Input::CATCH_UP; });
+    uint32_t advances = std::distance(inputs.begin(), first);
+
+    Replay result;
+    MonochromeShop shop(seed, advances);
+    for (uint32_t i = 0; i < advances; i++)
+    {
+        SolveSequenceResult res = {
+            .customer = CustomerType::INVALID,
+            .item     = Item::INVALID,
+            .input    = Input::CATCH_UP,
+            .result   = InputResult::ADVANCE,
+        };
+        result.score += res.getScore(costs);
+        result.inputs.push_back(res);
+    }
+
+    for (auto it = first; it != inputs.end(); it++)
+    {
+        if (shop.hasEnded())
+        {
+            result.unused = std::distance(it, inputs.end());
+            break;
+        }
+
+        SolveSequenceResult res;
+        res.input    = *it;
+        res.customer = shop.getCustomer().type;
+        res.item     = shop.getCustomer().item;
+        res.result   = shop.input(*it);
+
+        result.score += res.getScore(costs);
+        if (endsCustomer(res.result)) result.customers++;
+        result.inputs.push_back(res);
+    }
+
+    result.profit = shop.getProfits();
+    result.ended  = shop.hasEnded();
+    return result;
+}
+
+bool verify(uint32_t seed, const ISolveEntry& entry, const CostProfile& costs)
+{
+    auto result = replay(seed, toInputs(entry.getInputs()), costs);
+    auto shop   = entry.getShop();
+
+    return result.inputs == entry.getInputs() && result.score == entry.getScore() &&
+           result.customers == entry.getCustomerCount() && result.profit == shop.getProfits() &&
+           result.ended == shop.hasEnded();
+}
+
+std::optional<std::vector<Input>> loadRoute(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Can't open route " << path << "\n";
+        return std::nullopt;
+    }
+
+    std::vector<Input> inputs;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream tokens(line);
+        std::string token;
+        while (tokens >> token)
+        {
+            auto input = parseInput(token);
+            if (!input) break;
+
+            inputs.push_back(*input);
+        }
+    }
+
+    if (inputs.empty())
+    {
+        std::cerr << path << ": no inputs found\n";
+        return std::nullopt;
+    }
+
+    return inputs;
+}
+
+void printReplay(const Replay& replay, std::ostream& out)
+{
+    for (auto& val : replay.inputs)
+        out << formatSequenceResult(val) << "\n";
+
+    out << "Customers: " << replay.customers << "\n";
+    out << "   Inputs: " << replay.inputs.size() << "\n";
+    out << "   Profit: " << replay.profit << "\n";
+    out << "    Score: " << replay.score << "\n";
+    if (replay.unused > 0) out << "   Unused: " << replay.unused << " inputs after the shop ended\n";
+    if (!replay.ended) out << "The shop hasn't ended\n";
+    out << "    Valid: " << (replay.isValid() ? "yes" : "no") << std::endl;
+}
+
+/*
+ * Fuzz implementation
+ */
+
+uint64_t fuzz(uint32_t seed, uint32_t iterations, std::ostream& out)
+{
+    std::mt19937 rng(seed);
+    Checks checks;
+
+    // the tables don't depend on the seed, every draw gets checked once
+    for (uint32_t raw = 0; raw < DW1Random::range; raw++)
+        checks.tables.expect(checkRawDraw(raw), seed, 0, raw, out);
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        uint32_t shopSeed = rng();
+        uint32_t advances = rng() % 4;
+        RngLookahead lookahead(shopSeed);
+
+        fuzzStream(shopSeed, advances, lookahead, rng, checks, out);
+
+        BestResult best;
+        HeuristicSolveEntry<DefaultCosts> heuristic(shopSeed, advances);
+        heuristic.next(best);
+        checks.heuristic.expect(verify(shopSeed, heuristic), shopSeed, advances, heuristic.getInputs().size(), out);
+        checkBounds(shopSeed, toInputs(heuristic.getInputs()), lookahead, checks.bound, out);
+
+        if (i % FUZZ_FRONTIER_INTERVAL == 0) fuzzFrontier(shopSeed, advances, lookahead, checks, out);
+    }
+
+    uint64_t mismatches = 0;
+    for (auto* check : { &checks.tables,
+                         &checks.stream,
+                         &checks.packed,
+                         &checks.bound,
+                         &checks.macro,
+                         &checks.frontier,
+                         &checks.children,
+                         &checks.heuristic })
+    {
+        out << std::format("{:10} {:10} checks {:6} mismatches\n", check->name, check->checks, check->mismatches);
+        mismatches += check->mismatches;
+    }
+
+    return mismatches;
+}
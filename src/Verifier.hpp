@@ -0,0 +1,55 @@
+#pragma once
+#include "CostProfile.hpp"
+#include "FullSolver.hpp"
+#include "MonochromeShop.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+constexpr uint32_t DEFAULT_FUZZ_ITERATIONS = 10000;
+constexpr uint32_t FUZZ_MAX_INPUTS         = 400; // per random input stream, far more than a shop takes to end
+constexpr uint32_t FUZZ_FRONTIER_INTERVAL  = 64;  // iterations between Frontier comparisons, they are expensive
+constexpr uint32_t FUZZ_FRONTIER_LEVELS    = 6;
+
+/*
+ * A sequence of inputs replayed against a plain MonochromeShop and scored with SolveSequenceResult::getScore.
+ * This is the reference every faster engine has to agree with.
+ */
+struct Replay
+{
+    std::vector<SolveSequenceResult> inputs;
+    uint32_t score     = 0;
+    uint32_t customers = 0;
+    uint32_t profit    = 0;
+    bool ended         = false;
+    size_t unused      = 0; // inputs left over after the shop ended
+
+    [[nodiscard]] bool isValid() const;
+};
+
+/*
+ * Replays the inputs from the given seed, leading CATCH_UPs are advances before the first customer spawns.
+ */
+Replay replay(uint32_t seed, const std::vector<Input>& inputs, const CostProfile& costs = DEFAULT_COSTS);
+
+/*
+ * Whether an entry found by a solver started from the seed matches its replay, input by input and in score.
+ */
+bool verify(uint32_t seed, const ISolveEntry& entry, const CostProfile& costs = DEFAULT_COSTS);
+
+/*
+ * Reads the inputs of a route, either as printed by the text output or as plain input names.
+ * Every line contributes its leading input names, everything else is ignored.
+ */
+std::optional<std::vector<Input>> loadRoute(const std::string& path);
+
+void printReplay(const Replay& replay, std::ostream& out);
+
+/*
+ * Drives the reference and the optimized engines in lockstep on random seeds and input streams.
+ * Returns the number of mismatches, each of them is described on the stream.
+ */
+uint64_t fuzz(uint32_t seed, uint32_t iterations, std::ostream& out);